@@ -0,0 +1,74 @@
+#define CORETEST_IMPLEMENTATION
+
+#include "../coretest/coretest.hpp"
+
+// Measures the cost of a passing check
+// The eager loop formats both operands of every check, as the assertion macros previously did
+// The worker loop checks from threads started outside the runner, which count into their own buffers
+
+const size_t check_count = 10000000;
+
+std::vector<int> first_values;
+std::vector<int> second_values;
+
+double nanoseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+double run_eager() {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < check_count; i++) {
+        int first = first_values[i];
+        int second = second_values[i];
+        std::string first_string = coretest::get_string(first);
+        std::string second_string = coretest::get_string(second);
+        coretest::current_context->result.assertions++;
+        if (first != second) {
+            coretest::record_assertion(false, coretest::AssertionType::CHECK, coretest::ComparisonType::EQUAL, first_string, second_string);
+        }
+    }
+    return nanoseconds_since(start) / check_count;
+}
+
+double run_lazy() {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < check_count; i++) {
+        CHECK_EQUAL(first_values[i], second_values[i]);
+    }
+    return nanoseconds_since(start) / check_count;
+}
+
+double run_workers() {
+    const size_t worker_count = 4;
+    std::vector<double> durations(worker_count);
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < worker_count; worker++) {
+        workers.emplace_back([worker, &durations] {
+            // Thread CPU time, as workers may share cores
+            int64_t start_user, start_system, user, system;
+            coretest::get_cpu_time(start_user, start_system);
+            for (size_t i = worker; i < check_count; i += worker_count) {
+                CHECK_EQUAL(first_values[i], second_values[i]);
+            }
+            coretest::get_cpu_time(user, system);
+            durations[worker] = (double)(user - start_user + system - start_system) / (check_count / worker_count);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    return *std::min_element(durations.begin(), durations.end());
+}
+
+int main() {
+    for (size_t i = 0; i < check_count; i++) {
+        first_values.push_back((int)(i * 2654435761u));
+        second_values.push_back((int)(i * 2654435761u));
+    }
+    // Count passed checks inline, as inside a test case run by the runner
+    coretest::current_context->count_passed_inline = true;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "eager formatting: " << run_eager() << " ns per passing check" << '\n';
+    std::cout << "lazy formatting:  " << run_lazy() << " ns per passing check" << '\n';
+    std::cout << "worker threads:   " << run_workers() << " ns per passing check" << '\n';
+}
@@ -0,0 +1,98 @@
+#define CORETEST_IMPLEMENTATION
+
+#include <cstdlib>
+#include <fstream>
+
+#include "../coretest/coretest.hpp"
+
+// Measures compile time and object size of a generated source file with N assertions
+// The eager file expands each assertion as the macros previously did, formatting operands inline at every call site
+
+const size_t checks_per_test = 100;
+
+const char *eager_macros = R"(
+template <typename First, typename Second>
+inline void eager_add_assertion(bool passed, coretest::AssertionType type, coretest::ComparisonType comparison, const First &first, const Second &second) {
+    coretest::current_context->result.assertions++;
+    if (passed && !coretest::show_successful) {
+        return;
+    }
+    coretest::AllocationPause pause;
+    coretest::record_assertion(passed, type, comparison, coretest::get_string(first), coretest::get_string(second));
+}
+
+#define EAGER_CHECK(x, y, comparison, op) \
+    { \
+        auto first = x; \
+        auto second = y; \
+        eager_add_assertion(((first op second) ? true : false), coretest::AssertionType::CHECK, coretest::ComparisonType::comparison, first, second); \
+    }
+#undef CHECK_EQUAL
+#undef CHECK_LESS
+#define CHECK_EQUAL(x, y) EAGER_CHECK(x, y, EQUAL, ==)
+#define CHECK_LESS(x, y) EAGER_CHECK(x, y, LESS, <)
+)";
+
+// Write source file with check_count assertions over integers, floats and strings
+void generate_source(const std::string &file_name, size_t check_count, bool eager) {
+    std::ofstream file(file_name);
+    file << "#include <coretest/coretest.hpp>\n";
+    if (eager) {
+        file << eager_macros;
+    }
+    file << "int values[" << checks_per_test << "];\n";
+    file << "double ratios[" << checks_per_test << "];\n";
+    file << "std::string names[" << checks_per_test << "];\n";
+    for (size_t i = 0; i < check_count; i++) {
+        if (i % checks_per_test == 0) {
+            file << (i == 0 ? "" : "}\n") << "TEST(generated_" << i / checks_per_test << ") {\n";
+        }
+        size_t index = i % checks_per_test;
+        switch (i % 3) {
+            case 0:
+                file << "    CHECK_EQUAL(values[" << index << "], " << index << ");\n";
+                break;
+            case 1:
+                file << "    CHECK_LESS(ratios[" << index << "], " << index << ".5);\n";
+                break;
+            default:
+                file << "    CHECK_EQUAL(names[" << index << "], \"name_" << index << "\");\n";
+                break;
+        }
+    }
+    if (check_count > 0) {
+        file << "}\n";
+    }
+}
+
+// Return size of file in bytes
+size_t get_file_size(const std::string &file_name) {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    return (size_t)file.tellg();
+}
+
+// Compile source file to an object file, returns compile time in seconds
+double compile(const std::string &source_name, const std::string &object_name) {
+    std::string command = std::string(CORETEST_CXX_COMPILER) + " -std=c++17 -O2 -I" + CORETEST_SOURCE_DIR + " -c " + source_name + " -o " + object_name;
+    auto start = std::chrono::steady_clock::now();
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "Failed to compile " << source_name << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    size_t check_count = argc > 1 ? std::stoul(argv[1]) : 2000;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << check_count << " checks\n";
+    for (bool eager : {true, false}) {
+        std::string source_name = eager ? "compile_benchmark_eager.cpp" : "compile_benchmark_lean.cpp";
+        std::string object_name = source_name + ".o";
+        generate_source(source_name, check_count, eager);
+        double seconds = compile(source_name, object_name);
+        std::cout << (eager ? "eager macros: " : "lean macros:  ") << seconds << " s, " << get_file_size(object_name) / 1024 << " KiB object" << '\n';
+        std::remove(source_name.c_str());
+        std::remove(object_name.c_str());
+    }
+}
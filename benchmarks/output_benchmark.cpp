@@ -0,0 +1,47 @@
+#define CORETEST_IMPLEMENTATION
+
+#include <cstdio>
+#include <fstream>
+
+#include "../coretest/coretest.hpp"
+
+// Measures output throughput of each reporter when every passing assertion is printed with -s
+
+const size_t check_count = 1000000;
+const char *output_file_name = "output_benchmark.txt";
+
+TEST(passing_checks) {
+    for (size_t i = 0; i < check_count; i++) {
+        CHECK_EQUAL(i, i);
+    }
+}
+
+// Return number of lines in file
+size_t count_lines(const char *file_name) {
+    std::ifstream file(file_name, std::ios::binary);
+    size_t lines = 0;
+    char buffer[64 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        lines += std::count(buffer, buffer + file.gcount(), '\n');
+    }
+    return lines;
+}
+
+int main() {
+    const char *reporters[] = {"console", "jsonl", "tap", "junit"};
+    for (const char *reporter : reporters) {
+        std::vector<std::string> args = {"output_benchmark", "-s", "--log-limit", "0", "-r", reporter, "-o", output_file_name};
+        std::vector<char *> argv;
+        for (std::string &arg : args) {
+            argv.push_back(&arg[0]);
+        }
+        auto start = std::chrono::steady_clock::now();
+        coretest::run_main((int)argv.size(), argv.data());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t lines = count_lines(output_file_name);
+        std::remove(output_file_name);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << reporter << ": " << lines << " lines in " << std::setprecision(3) << seconds << " s, "
+                  << std::setprecision(0) << lines / seconds << " lines per second" << '\n';
+    }
+}
@@ -0,0 +1,52 @@
+#define CORETEST_IMPLEMENTATION
+
+#include "../coretest/coretest.hpp"
+
+// Measures range assertions against a loop of single checks over the same buffers
+
+const size_t element_count = 10000000;
+
+std::vector<float> first_values;
+std::vector<float> second_values;
+
+double milliseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double run_loop() {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < element_count; i++) {
+        CHECK_EQUAL(first_values[i], second_values[i]);
+    }
+    return milliseconds_since(start);
+}
+
+double run_range_equal() {
+    auto start = std::chrono::steady_clock::now();
+    CHECK_RANGE_EQUAL(first_values, second_values);
+    return milliseconds_since(start);
+}
+
+double run_range_near() {
+    auto start = std::chrono::steady_clock::now();
+    CHECK_RANGE_NEAR(first_values, second_values, 1e-6, 1e-6);
+    return milliseconds_since(start);
+}
+
+double run_ulp() {
+    auto start = std::chrono::steady_clock::now();
+    CHECK_ULP(first_values, second_values, 4);
+    return milliseconds_since(start);
+}
+
+int main() {
+    for (size_t i = 0; i < element_count; i++) {
+        first_values.push_back((float)i * 0.5f);
+    }
+    second_values = first_values;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "loop of CHECK_EQUAL: " << run_loop() << " ms" << '\n';
+    std::cout << "CHECK_RANGE_EQUAL:   " << run_range_equal() << " ms" << '\n';
+    std::cout << "CHECK_RANGE_NEAR:    " << run_range_near() << " ms" << '\n';
+    std::cout << "CHECK_ULP:           " << run_ulp() << " ms" << '\n';
+}
@@ -0,0 +1,37 @@
+# coretest_discover_tests(<target> [TEST_PREFIX <prefix>] [EXTRA_ARGS <argument>...] [PROPERTIES <name> <value>...])
+#
+# Register each test case of a coretest executable as its own CTest test, so that ctest -j runs test cases in
+# parallel and schedules them by their recorded cost. Test cases are listed with --list-tests --format json each
+# time the target is built, so adding a TEST needs no change to CMake files.
+# Tags of a test case become its LABELS, TEST_SERIAL and TEST_CONCURRENT test cases are RUN_SERIAL, and
+# benchmarks are not registered. Requires CMake 3.19 to read the listing.
+set(_CORETEST_ADD_TESTS_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/CoretestAddTests.cmake")
+
+function(coretest_discover_tests target)
+    if(CMAKE_VERSION VERSION_LESS 3.19)
+        message(FATAL_ERROR "coretest_discover_tests requires CMake 3.19 or newer")
+    endif()
+    cmake_parse_arguments(PARSE_ARGV 1 _discover "" "TEST_PREFIX" "EXTRA_ARGS;PROPERTIES")
+    set(include_file "${CMAKE_CURRENT_BINARY_DIR}/${target}_include.cmake")
+    set(tests_file "${CMAKE_CURRENT_BINARY_DIR}/${target}_tests.cmake")
+    add_custom_command(
+        TARGET ${target} POST_BUILD
+        BYPRODUCTS "${tests_file}"
+        COMMAND "${CMAKE_COMMAND}"
+                -D "TEST_TARGET=${target}"
+                -D "TEST_EXECUTABLE=$<TARGET_FILE:${target}>"
+                -D "TEST_PREFIX=${_discover_TEST_PREFIX}"
+                -D "TEST_EXTRA_ARGS=${_discover_EXTRA_ARGS}"
+                -D "TEST_PROPERTIES=${_discover_PROPERTIES}"
+                -D "CTEST_FILE=${tests_file}"
+                -P "${_CORETEST_ADD_TESTS_SCRIPT}"
+        VERBATIM)
+    # CTest reads the include file, the listing only exists once the target has been built
+    file(WRITE "${include_file}"
+         "if(EXISTS \"${tests_file}\")\n"
+         "    include(\"${tests_file}\")\n"
+         "else()\n"
+         "    add_test(${target}_NOT_BUILT ${target}_NOT_BUILT)\n"
+         "endif()\n")
+    set_property(DIRECTORY APPEND PROPERTY TEST_INCLUDE_FILES "${include_file}")
+endfunction()
@@ -0,0 +1,52 @@
+# Run by coretest_discover_tests after TEST_TARGET is built, writes CTEST_FILE with a test per test case
+cmake_minimum_required(VERSION 3.19)
+
+execute_process(
+    COMMAND "${TEST_EXECUTABLE}" --list-tests --format json
+    OUTPUT_VARIABLE listing
+    ERROR_VARIABLE error
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Failed to list test cases of ${TEST_TARGET} (${result}):\n${error}")
+endif()
+
+# Arguments are written as bracket arguments so that names and values are not expanded by CTest
+set(extra_args "")
+foreach(argument IN LISTS TEST_EXTRA_ARGS)
+    string(APPEND extra_args " [==[${argument}]==]")
+endforeach()
+set(properties "")
+foreach(value IN LISTS TEST_PROPERTIES)
+    string(APPEND properties " [==[${value}]==]")
+endforeach()
+
+set(content "")
+string(JSON count LENGTH "${listing}" tests)
+if(count GREATER 0)
+    math(EXPR last "${count} - 1")
+    foreach(i RANGE ${last})
+        string(JSON benchmark GET "${listing}" tests ${i} benchmark)
+        if(benchmark)
+            continue()
+        endif()
+        string(JSON name GET "${listing}" tests ${i} name)
+        string(JSON tags GET "${listing}" tests ${i} tags)
+        string(JSON serial GET "${listing}" tests ${i} serial)
+        # Tags in the form [tag1][tag2] become the labels tag1;tag2
+        string(REGEX MATCHALL "\\[[^]]*\\]" tag_list "${tags}")
+        set(labels "")
+        foreach(tag IN LISTS tag_list)
+            string(REGEX REPLACE "^\\[(.*)\\]$" "\\1" tag "${tag}")
+            list(APPEND labels "${tag}")
+        endforeach()
+        set(test_name "${TEST_PREFIX}${name}")
+        string(APPEND content "add_test([==[${test_name}]==] [==[${TEST_EXECUTABLE}]==] [==[[${name}]]==]${extra_args})\n")
+        string(APPEND content "set_tests_properties([==[${test_name}]==] PROPERTIES LABELS [==[${labels}]==]")
+        if(serial)
+            string(APPEND content " RUN_SERIAL TRUE")
+        endif()
+        string(APPEND content "${properties})\n")
+    endforeach()
+endif()
+
+file(WRITE "${CTEST_FILE}" "${content}")
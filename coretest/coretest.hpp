@@ -1,17 +1,87 @@
 #ifndef CORETEST_HPP
 #define CORETEST_HPP
 
+// Every source file of a test executable includes this header to declare test cases
+// One source file defines CORETEST_MAIN before including it, to define the runner and main
+// Or it defines CORETEST_IMPLEMENTATION to define the runner only, and calls coretest::run_main from its own main
+#if (defined(CORETEST_MAIN) || defined(CORETEST_IMPLEMENT_WITHOUT_MAIN)) && !defined(CORETEST_IMPLEMENTATION)
+#define CORETEST_IMPLEMENTATION
+#endif
+
 #include <math.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define CORETEST_HAS_FORK
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define CORETEST_HAS_PERF_EVENTS
+#endif
+
+#if (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CORETEST_HAS_X86_SIMD
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CORETEST_NOINLINE __attribute__((noinline))
+#define CORETEST_COLD __attribute__((cold))
+#elif defined(_MSC_VER)
+#define CORETEST_NOINLINE __declspec(noinline)
+#define CORETEST_COLD
+#else
+#define CORETEST_NOINLINE
+#define CORETEST_COLD
+#endif
+
+// A failed REQUIRE returns from the enclosing function instead of throwing when exceptions are disabled
+// Defining CORETEST_NO_EXCEPTIONS selects this with exceptions enabled, to avoid the cost of unwinding
+#if !defined(CORETEST_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define CORETEST_NO_EXCEPTIONS
+#endif
+
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <exception>
-#include <fstream>
 #include <functional>
 #include <iomanip>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -29,7 +99,12 @@ enum class ComparisonType {
     LESS,
     LESS_EQUAL,
     GREATER,
-    GREATER_EQUAL
+    GREATER_EQUAL,
+    NO_ALLOCATIONS,
+    MAX_ALLOCATIONS,
+    RANGE_EQUAL,
+    RANGE_NEAR,
+    ULP
 };
 
 // Error handling
@@ -37,483 +112,4834 @@ struct CoreTestError : public std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
+// Report error that prevents tests from running, exits with a failure status when exceptions are disabled
+[[noreturn]] inline void raise_error(const std::string &message) {
+#if defined(CORETEST_NO_EXCEPTIONS)
+    std::fprintf(stderr, "%s\n", message.c_str());
+    std::exit(EXIT_FAILURE);
+#else
+    throw CoreTestError(message);
+#endif
+}
+
+// Registered test case, linked into the registry when it is constructed
+// Test cases are never copied, the runner refers to them by pointer
 struct Test {
-    std::function<void()> function;
-    std::string test_name;
-    std::string file_name;
+    Test(void (*new_function)(), const char *new_test_name, const char *new_file_name, int new_line_number, const char *new_tags = "", bool new_serial = false, bool new_benchmark = false, int64_t new_timeout = 0, size_t new_threads = 0);
+    Test(const Test &) = delete;
+    Test &operator=(const Test &) = delete;
+
+    void (*function)();
+    const char *test_name;
+    const char *file_name;
     int line_number;
+    // Tags in the form "[tag1][tag2]"
+    const char *tags;
+    // Test case must not run concurrently with other test cases
+    bool serial;
+    // Test case is a benchmark, its function is one iteration
+    bool benchmark;
+    // Timeout in milliseconds overriding --timeout, 0 if none is given
+    int64_t timeout;
+    // Number of threads running the body at once for TEST_CONCURRENT, 0 for other test cases
+    size_t threads;
+    // Next test case in registration order
+    Test *next = nullptr;
+};
+
+// Return timeout given after the tags of a test case in milliseconds, 0 if none is given
+// The test case macros append 0, which is the only argument if no tags are given
+constexpr int64_t get_timeout_argument(int) {
+    return 0;
+}
+
+template <typename... Rest>
+constexpr int64_t get_timeout_argument(const char *, Rest...) {
+    return 0;
+}
+
+template <typename... Rest>
+constexpr int64_t get_timeout_argument(int64_t milliseconds, Rest...) {
+    return milliseconds;
+}
+
+template <typename Rep, typename Period, typename... Rest>
+constexpr int64_t get_timeout_argument(std::chrono::duration<Rep, Period> duration, Rest...) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+// Intrusive list of registered test cases, constant initialized so it is usable during static initialization
+struct TestRegistry {
+    Test *first = nullptr;
+    Test *last = nullptr;
+    size_t size = 0;
 };
 
+// Formatted assertion, operand text is owned by an AssertionLog
 struct Assertion {
     bool passed;
     AssertionType type;
     ComparisonType comparison;
-    std::string first;
-    std::string second;
-    std::string suffix;
-    std::string comparison_operator;
-
-    Assertion(bool new_passed, AssertionType new_type, ComparisonType new_comparison, std::string new_first, std::string new_second = "", std::string new_suffix = "", std::string new_comparison_operator = "") {
-        passed = new_passed;
-        type = new_type;
-        comparison = new_comparison;
-        first = new_first;
-        second = new_second;
-        suffix = new_suffix;
-        comparison_operator = new_comparison_operator;
-    }
+    std::string_view first;
+    std::string_view second;
+    // Written by REQUIRE or CHECK as an expression rather than by a named comparison macro
+    bool expression;
+    // Index of the TEST_CONCURRENT thread that made the assertion, -1 for other threads
+    int thread;
 };
 
-struct PushTest {
-    PushTest(std::function<void()> &&test, std::string test_name, std::string file_name, int line_number);
+// Heap allocations made by a test case, counted if CORETEST_COUNT_ALLOCATIONS is defined
+struct AllocationCounters {
+    size_t allocations = 0;
+    size_t frees = 0;
+    size_t bytes = 0;
+    // Bytes allocated and not freed, relative to the start of the test case
+    int64_t live_bytes = 0;
+    int64_t peak_live_bytes = 0;
 };
 
-const int separator_length = 80;
-// Holds all tests
-std::vector<Test> tests;
-// Holds test names
-std::map<std::string, int> test_names;
-// Holds user specifed tests to run
-std::vector<std::string> specified_tests;
-// Holds all assertions
-std::vector<Assertion> assertions;
-// Holds duration of each test case
-std::vector<double> durations;
-std::ofstream file_out;
-std::streambuf *coutbuf;
+// Hardware performance counter values, counted if --perf-counters is given
+struct PerfCounts {
+    static const int counter_count = 5;
 
-PushTest::PushTest(std::function<void()> &&test, std::string test_name, std::string file_name, int line_number) {
-    tests.push_back({test, test_name, file_name, line_number});
-    test_names[test_name] = tests.size();
-}
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t branch_misses = 0;
+    uint64_t l1d_misses = 0;
+    uint64_t llc_misses = 0;
+    // Bit i is set if counter i could be opened, in the order of the fields above
+    unsigned available = 0;
 
-class Timer {
-   public:
-    Timer() {
-        start_timepoint = std::chrono::high_resolution_clock::now();
+    inline uint64_t &operator[](int counter) {
+        uint64_t *values[counter_count] = {&cycles, &instructions, &branch_misses, &l1d_misses, &llc_misses};
+        return *values[counter];
     }
 
-    ~Timer() {
-        stop();
+    inline uint64_t operator[](int counter) const {
+        return const_cast<PerfCounts &>(*this)[counter];
     }
 
-    void stop() {
-        double duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_timepoint).count();
-        durations.push_back(duration * 0.001);
+    inline bool is_available(int counter) const {
+        return (available >> counter) & 1;
     }
 
-   private:
-    std::chrono::time_point<std::chrono::high_resolution_clock> start_timepoint;
+    // Instructions per cycle
+    inline double ipc() const {
+        return cycles > 0 ? (double)instructions / cycles : 0;
+    }
+
+    PerfCounts operator-(const PerfCounts &other) const {
+        PerfCounts difference;
+        for (int counter = 0; counter < counter_count; counter++) {
+            difference[counter] = (*this)[counter] - other[counter];
+        }
+        difference.available = available & other.available;
+        return difference;
+    }
 };
 
-// Command line option
-class Option {
+// Assertion counters of a single test case
+struct TestResult {
+    size_t assertions = 0;
+    size_t assertions_failed = 0;
+    // Assertions that were not stored because the log was full
+    size_t assertions_dropped = 0;
+    AllocationCounters allocations;
+    PerfCounts perf;
+};
+
+// Capped log of assertions to print for a single test case
+// Operand text is copied into reusable chunks so that clearing the log frees nothing
+class AssertionLog {
    public:
-    Option(bool &ref) : option_reference(ref) {}
+    static const size_t chunk_size = 64 * 1024;
 
-    inline auto &operator[](const std::string name) {
-        args.push_back(name);
-        return *this;
+    // Returns false if the log is full and the assertion was not stored
+    bool push(bool passed, AssertionType type, ComparisonType comparison, const std::string &first, const std::string &second, bool expression, int thread) {
+        if (limit != 0 && entries.size() >= limit) {
+            return false;
+        }
+        std::string_view first_view = store(first);
+        std::string_view second_view = store(second);
+        entries.push_back({passed, type, comparison, first_view, second_view, expression, thread});
+        return true;
     }
 
-    inline auto &operator()(std::string new_description, std::string new_name) {
-        description = new_description;
-        name = new_name;
-        return *this;
+    inline void clear(size_t new_limit) {
+        limit = new_limit;
+        entries.clear();
+        oversized.clear();
+        chunk_index = 0;
+        chunk_offset = 0;
     }
 
-    bool is_match(std::string argument) {
-        for (auto arg : args) {
-            if (argument == arg) {
-                option_reference = true;
-                return true;
+    inline const std::vector<Assertion> &get_assertions() const {
+        return entries;
+    }
+
+   private:
+    std::string_view store(const std::string &text) {
+        if (text.size() > chunk_size) {
+            // Oversized text gets a chunk of its own
+            oversized.emplace_back(new char[text.size()]);
+            std::copy(text.begin(), text.end(), oversized.back().get());
+            return std::string_view(oversized.back().get(), text.size());
+        }
+        if (chunk_index == chunks.size() || chunk_offset + text.size() > chunk_size) {
+            if (chunk_index < chunks.size()) {
+                // Current chunk is full, move to next chunk
+                chunk_index++;
+                chunk_offset = 0;
+            }
+            if (chunk_index == chunks.size()) {
+                chunks.emplace_back(new char[chunk_size]);
             }
         }
-        return false;
+        char *destination = chunks[chunk_index].get() + chunk_offset;
+        std::copy(text.begin(), text.end(), destination);
+        chunk_offset += text.size();
+        return std::string_view(destination, text.size());
     }
 
-    inline std::vector<std::string> get_args() {
-        return args;
-    }
+    size_t limit = 1024;
+    std::vector<Assertion> entries;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::vector<std::unique_ptr<char[]>> oversized;
+    size_t chunk_index = 0;
+    size_t chunk_offset = 0;
+};
 
-    inline std::string get_description() {
-        return description;
+// Wall and CPU time of a test case in nanoseconds
+struct TestTiming {
+    int64_t wall = 0;
+    int64_t user = 0;
+    int64_t system = 0;
+};
+
+// Group of hardware performance counters measuring the thread that opened it
+class PerfCounterGroup {
+   public:
+    ~PerfCounterGroup() {
+        close();
     }
 
-    inline void set_require_argument(bool require) {
-        require_argument = require;
+    // Open counters for the calling thread, returns false if no counter could be opened
+    bool open(std::string &error) {
+#if defined(CORETEST_HAS_PERF_EVENTS)
+        if (owner == getpid()) {
+            return leader != -1;
+        }
+        // Descriptors inherited through fork measure the parent, so they are reopened
+        close();
+        owner = getpid();
+        const uint32_t types[PerfCounts::counter_count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+        const uint64_t configs[PerfCounts::counter_count] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+        for (int counter = 0; counter < PerfCounts::counter_count; counter++) {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = types[counter];
+            attributes.config = configs[counter];
+            attributes.disabled = (leader == -1) ? 1 : 0;
+            // User space only, which is allowed with perf_event_paranoid up to 2
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+            if (fd == -1) {
+                if (leader == -1) {
+                    error = std::string("perf_event_open: ") + strerror(errno);
+                }
+                continue;
+            }
+            if (leader == -1) {
+                leader = fd;
+            }
+            fds[opened_count] = fd;
+            opened[opened_count++] = counter;
+        }
+        return leader != -1;
+#else
+        error = "hardware performance counters are only supported on Linux";
+        return false;
+#endif
     }
 
-    inline bool get_require_argument() {
-        return require_argument;
+    void start() {
+#if defined(CORETEST_HAS_PERF_EVENTS)
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        running = true;
+#endif
     }
 
-    inline void set_argument(std::string new_argument) {
-        argument = new_argument;
+    void stop() {
+#if defined(CORETEST_HAS_PERF_EVENTS)
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        running = false;
+#endif
     }
 
-    inline std::string get_argument() {
-        return argument;
+    inline bool is_running() const {
+        return running;
     }
 
-    inline std::string get_name() {
-        return name;
+    // Read counters, scaled up if the kernel multiplexed them
+    PerfCounts read() const {
+        PerfCounts counts;
+#if defined(CORETEST_HAS_PERF_EVENTS)
+        if (leader == -1) {
+            return counts;
+        }
+        uint64_t buffer[3 + PerfCounts::counter_count];
+        if (::read(leader, buffer, sizeof(buffer)) <= 0) {
+            return counts;
+        }
+        uint64_t time_enabled = buffer[1];
+        uint64_t time_running = buffer[2];
+        double scale = (time_running > 0 && time_running < time_enabled) ? (double)time_enabled / time_running : 1;
+        for (int i = 0; i < opened_count && i < (int)buffer[0]; i++) {
+            counts[opened[i]] = (uint64_t)(buffer[3 + i] * scale);
+            counts.available |= 1u << opened[i];
+        }
+#endif
+        return counts;
     }
 
    private:
-    bool &option_reference;
-    bool require_argument = false;
-    std::vector<std::string> args;
-    std::string description;
-    std::string argument;
-    std::string name;
+    void close() {
+#if defined(CORETEST_HAS_PERF_EVENTS)
+        for (int i = 0; i < opened_count; i++) {
+            ::close(fds[i]);
+        }
+#endif
+        opened_count = 0;
+        leader = -1;
+        running = false;
+    }
+
+    int leader = -1;
+    int fds[PerfCounts::counter_count];
+    // Counter index of each opened descriptor, in group read order
+    int opened[PerfCounts::counter_count];
+    int opened_count = 0;
+    int owner = -1;
+    bool running = false;
 };
 
-class TestCaseOption {
+// Statistics of benchmark samples, times are in nanoseconds per iteration
+struct BenchmarkStatistics {
+    size_t iterations = 0;
+    size_t samples = 0;
+    double mean = 0;
+    double median = 0;
+    double stddev = 0;
+    double min = 0;
+    // Counter values of all samples, if --perf-counters is given
+    PerfCounts perf;
+};
+
+// Throughput of a TEST_CONCURRENT test case, times are in nanoseconds
+struct StressStatistics {
+    size_t threads = 0;
+    size_t rounds = 0;
+    // Wall time of all rounds
+    int64_t wall = 0;
+    // Time each thread spent running the body
+    std::vector<int64_t> busy;
+};
+
+// Statistics of repeated runs of a test case for baselines, times are in nanoseconds
+struct DurationStatistics {
+    size_t samples = 0;
+    double median = 0;
+    // Median absolute deviation, scaled to estimate the standard deviation
+    double deviation = 0;
+    double min = 0;
+};
+
+// Log-linear histogram of durations in nanoseconds with a fixed number of buckets, so that a soak of any length uses the same memory
+// Values keep their 6 most significant bits, a bucket midpoint is within 1.6% of the values in it
+// Buckets cover durations up to 2^40 ns, about 18 minutes, longer ones share the last bucket
+// Buckets are allocated on the first recorded value, so test cases that never run cost no buckets
+class DurationHistogram {
    public:
-    TestCaseOption() {}
-    bool is_match(std::string argument) {
-        if (argument[0] == '[' && argument[argument.length() - 1] == ']') {
-            // Get test name without [ ] chars
-            std::string test_name = argument.substr(1, argument.length() - 2);
-            // Remove whitespace
-            test_name.erase(std::remove(test_name.begin(), test_name.end(), ' '), test_name.end());
-            specified_tests.push_back(test_name);
-            return true;
+    static const int significant_bits = 6;
+    static const int value_bits = 40;
+    static const size_t half_count = size_t(1) << (significant_bits - 1);
+    static const size_t bucket_count = (value_bits - significant_bits + 2) * half_count;
+
+    void record(int64_t duration) {
+        uint64_t value = duration > 0 ? (uint64_t)duration : 0;
+        if (!buckets) {
+            buckets.reset(new uint64_t[bucket_count]());
         }
-        return false;
+        buckets[get_index(std::min(value, (uint64_t(1) << value_bits) - 1))]++;
+        if (count == 0 || value < min) {
+            min = value;
+        }
+        max = std::max(max, value);
+        count++;
     }
-};
 
-// Declare test case command line argument
-TestCaseOption test_case_option;
+    inline size_t get_count() const {
+        return count;
+    }
 
-// Holds command line argument options
-std::unordered_map<std::string, Option> options_unordered_map;
-bool show_successful = false;
-bool show_list = false;
-bool show_help = false;
-bool send_to_file = false;
-bool silence_output = false;
-bool show_durations = false;
+    inline uint64_t get_max() const {
+        return max;
+    }
 
-template <typename First, typename... Rest>
-void add_options(First first, Rest... rest) {
-    add_options(first);
-    add_options(rest...);
-}
+    // Return value at fraction of the recorded values, such as 0.99 for p99, as the midpoint of its bucket
+    uint64_t get_percentile(double fraction) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max((uint64_t)1, (uint64_t)std::ceil(fraction * count));
+        uint64_t seen = 0;
+        for (size_t index = 0; index < bucket_count; index++) {
+            seen += buckets[index];
+            if (seen >= rank) {
+                int shift = get_shift(index);
+                uint64_t lower = (uint64_t)(index - shift * half_count) << shift;
+                uint64_t middle = lower + ((uint64_t(1) << shift) - 1) / 2;
+                return std::min(std::max(middle, min), max);
+            }
+        }
+        return max;
+    }
 
-template <>
-void add_options(Option option) {
-    options_unordered_map.insert(std::make_pair(option.get_name(), option));
-}
+   private:
+    // Values below 2 * half_count have a bucket of their own, larger values are shifted down to their significant bits
+    static inline size_t get_index(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        int top_bit = value != 0 ? 63 - __builtin_clzll(value) : 0;
+#else
+        int top_bit = 0;
+        for (uint64_t rest = value >> 1; rest != 0; rest >>= 1) {
+            top_bit++;
+        }
+#endif
+        int shift = std::max(0, top_bit - (significant_bits - 1));
+        return shift * half_count + (size_t)(value >> shift);
+    }
 
-// Initialize options
-void initialize_options() {
-    Option help(show_help);
-    help["-?"]["-h"]["--help"]("display usage information", "help");
-    Option list(show_list);
-    list["-l"]["--list-tests"]("list all test cases", "list");
-    Option successful_tests(show_successful);
-    successful_tests["-s"]["--success"]("include successful tests in output", "successful_tests");
-    Option out(send_to_file);
-    out["-o"]["--out"]("send output to a given file", "out");
-    out.set_require_argument(true);
-    Option quiet(silence_output);
-    quiet["-q"]["--quiet"]("disable all logging", "quiet");
-    Option duration(show_durations);
-    duration["-d"]["--durations"]("show duration of each test case", "duration");
-    add_options(list,
-                successful_tests,
-                help,
-                out,
-                quiet,
-                duration);
-}
+    static inline int get_shift(size_t index) {
+        return index < 2 * half_count ? 0 : (int)(index / half_count) - 1;
+    }
 
-// Redirects cout to file
-void redirect_cout_to_file() {
-    // Get file argument from option
-    Option option = options_unordered_map.at("out");
-    std::string file_name = option.get_argument();
-    // Redirect cout output to file
-    file_out.open(file_name);
-    coutbuf = std::cout.rdbuf();
-    std::cout.rdbuf(file_out.rdbuf());
-}
+    std::unique_ptr<uint64_t[]> buckets;
+    size_t count = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+};
 
-// Return std::string based on type
-template <typename T>
-inline std::string get_string(T var) {
-    // Argument given is numeric value, return std::to_string
-    return std::to_string(var);
-}
+// Change of a test case duration compared with its baseline
+enum class BaselineChange { NONE, MISSING, UNCHANGED, REGRESSION, IMPROVEMENT };
 
-template <>
-inline std::string get_string(std::string var) {
-    // Argument given is already a string, simply return
-    return var;
-}
+// Fixed point number written to an OutputBuffer with precision digits after the point
+struct FixedPoint {
+    double value;
+    int precision;
+};
 
-template <>
-inline std::string get_string(const char *var) {
-    // Argument given is const char*, convert to string
-    std::string new_var = var;
-    return new_var;
-}
+// Reusable output buffer with its own integer and float formatting
+// Bound to standard output or a file, the buffer is written with one write per chunk; otherwise it holds text in memory
+class OutputBuffer {
+   public:
+    static const size_t chunk_size = 64 * 1024;
 
-template <>
-inline std::string get_string(char var) {
-    // Argument given is a char, return with string constructor
-    return std::string(1, var);
-}
+    OutputBuffer() = default;
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
 
-void add_assertion(Assertion &assertion) {
-    switch (assertion.comparison) {
-        case ComparisonType::EQUAL:
-            assertion.comparison_operator = " == ";
-            assertion.suffix = "EQUAL";
-            break;
-        case ComparisonType::TRUE:
-            assertion.second = "true";
-            assertion.comparison_operator = " == ";
-            assertion.suffix = "TRUE";
-            break;
-        case ComparisonType::FALSE:
-            assertion.second = "false";
-            assertion.comparison_operator = " == ";
-            assertion.suffix = "FALSE";
-            break;
-        case ComparisonType::NOT_EQUAL:
-            assertion.comparison_operator = " != ";
-            assertion.suffix = "NOT_EQUAL";
-            break;
-        case ComparisonType::LESS:
-            assertion.comparison_operator = " < ";
-            assertion.suffix = "LESS";
-            break;
-        case ComparisonType::LESS_EQUAL:
-            assertion.comparison_operator = " <= ";
-            assertion.suffix = "LESS_EQUAL";
-            break;
-        case ComparisonType::GREATER:
-            assertion.comparison_operator = " > ";
-            assertion.suffix = "GREATER";
-            break;
-        case ComparisonType::GREATER_EQUAL:
-            assertion.comparison_operator = " >= ";
-            assertion.suffix = "GREATER_EQUAL";
-            break;
-    }
-    assertions.push_back(assertion);
-    if (assertion.passed == false) {
-        switch (assertion.type) {
-            case AssertionType::REQUIRE:
-                throw CoreTestError("Failed require encountered");
-                break;
-            default:
-                break;
-        }
+    ~OutputBuffer() {
+        close();
     }
-}
 
-// Return if any assertion from start_index to end_index have failed
-bool has_failed(size_t start_index, size_t end_index) {
-    for (size_t i = start_index; i < end_index; i++) {
-        if (assertions[i].passed == false) {
-            return true;
-        }
+    void open_standard_output() {
+        close();
+#if defined(CORETEST_HAS_FORK)
+        descriptor = STDOUT_FILENO;
+#else
+        file = stdout;
+#endif
+        buffer.reserve(chunk_size);
     }
-    return false;
-}
 
-// Output functions
+    // Returns false if the file could not be opened
+    bool open_file(const std::string &file_name) {
+        close();
+#if defined(CORETEST_HAS_FORK)
+        descriptor = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        owns_file = descriptor != -1;
+#else
+        file = fopen(file_name.c_str(), "wb");
+        owns_file = file != nullptr;
+#endif
+        buffer.reserve(chunk_size);
+        return owns_file;
+    }
 
-void print_option(std::string args, std::string description, int max_argument_length) {
-    std::cout << std::string(4, ' ') << args << std::string((max_argument_length - args.length()) + 5, ' ') << description << '\n';
-}
+    // Write held text and detach from the file, the buffer then holds text in memory
+    void close() {
+        flush();
+#if defined(CORETEST_HAS_FORK)
+        if (owns_file) {
+            ::close(descriptor);
+        }
+        descriptor = -1;
+#else
+        if (owns_file) {
+            fclose(file);
+        }
+        file = nullptr;
+#endif
+        owns_file = false;
+    }
 
-void print_help() {
-    std::cout << '\n';
-    std::cout << "usage:" << '\n';
-    std::cout << std::string(4, ' ') << "<executable> [<test name> ... ] options"
-              << "\n\n";
-    std::cout << "options:" << '\n';
-    std::vector<std::string> args;
-    std::vector<std::string> descriptions;
-    int max_argument_length = -1;
-    for (std::pair<std::string, Option> element : options_unordered_map) {
-        Option option = element.second;
-        // Compose args and description string
-        std::string option_args;
-        std::string option_description;
-        std::vector<std::string> option_args_vector = option.get_args();
-        for (size_t i = 0; i < option_args_vector.size(); i++) {
-            option_args += option_args_vector[i];
-            if (i != option_args_vector.size() - 1) {
-                // Not last arg iteration
-                option_args += ", ";
+    // Write held text to the file, nothing is done for buffers in memory
+    void flush() {
+        if (buffer.empty() || !is_bound()) {
+            return;
+        }
+#if defined(CORETEST_HAS_FORK)
+        if (descriptor == STDOUT_FILENO) {
+            // Keep order with output the code under test has written through stdio
+            fflush(stdout);
+        }
+        const char *data = buffer.data();
+        size_t size = buffer.size();
+        while (size > 0) {
+            ssize_t written = ::write(descriptor, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
             }
+            data += written;
+            size -= written;
         }
-        option_description = option.get_description();
-        max_argument_length = std::max((int)(option_args.size()), max_argument_length);
-        // Push into vectors
-        args.push_back(option_args);
-        descriptions.push_back(option_description);
+#else
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        fflush(file);
+#endif
+        buffer.clear();
     }
-    // Print options
-    for (size_t i = 0; i < args.size(); i++) {
-        print_option(args[i], descriptions[i], max_argument_length);
+
+    inline std::string_view view() const {
+        return buffer;
     }
-    std::cout << "\nSee documentation for more information" << '\n';
-}
 
-// Print formatted test name with file name and line number
-void print_test(Test test) {
-    std::cout << std::string(separator_length, '-') << '\n';
-    std::cout << test.test_name << " ( " << test.file_name << ":" << test.line_number << " )" << '\n';
-}
+    inline void clear() {
+        buffer.clear();
+    }
 
-// Print assertion
-void print_assertion(Assertion assertion) {
-    if (assertion.passed) {
-        std::cout << "PASSED:" << '\n';
-    } else {
-        std::cout << "FAILED:" << '\n';
+    inline OutputBuffer &operator<<(std::string_view text) {
+        buffer.append(text.data(), text.size());
+        return check_full();
     }
-    std::cout << std::string(4, ' ');
-    if (assertion.type == AssertionType::REQUIRE) {
-        std::cout << "REQUIRE_";
-    } else if (assertion.type == AssertionType::CHECK) {
-        std::cout << "CHECK_";
+
+    inline OutputBuffer &operator<<(const char *text) {
+        return *this << std::string_view(text);
     }
-    std::cout << assertion.suffix << "( " + assertion.first + assertion.comparison_operator + assertion.second + " )" << '\n';
-}
 
-// Print failed assertions from specified index and increment fail counter
-// Can be overriden to print passed assertions if show_successful flag is true
-void print_assertions(int initial_assertions, int &assertions_failed) {
-    for (size_t i = initial_assertions; i < assertions.size(); i++) {
-        Assertion assertion = assertions[i];
-        if (show_successful == true || assertion.passed == false) {
-            print_assertion(assertion);
-            if (assertion.passed == false) {
-                assertions_failed++;
-            }
-        }
+    inline OutputBuffer &operator<<(const std::string &text) {
+        return *this << std::string_view(text);
     }
-}
 
-// Print end results
-void print_results(int tests_failed, int assertions_failed) {
-    std::cout << '\n';
-    if (tests_failed > 0) {
-        // Get maximum string size for counts for output alignment
-        int tests_count_size = std::to_string(tests.size()).length();
-        int assertions_count_size = std::to_string(assertions.size()).length();
-        int max_size = std::max(tests_count_size, assertions_count_size);
-        std::cout << std::string(separator_length, '=') << '\n';
-        std::cout << "test cases: " << tests.size() << std::string((max_size - tests_count_size), ' ') << " | " << tests_failed << " failed" << '\n';
-        std::cout << "assertions: " << assertions.size() << std::string((max_size - assertions_count_size), ' ') << " | " << assertions_failed << " failed" << '\n';
-    } else {
+    inline OutputBuffer &operator<<(char c) {
+        buffer.push_back(c);
+        return check_full();
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value, int>::type = 0>
+    inline OutputBuffer &operator<<(T value) {
+        char digits[24];
+        size_t length = format_integer(value, digits);
+        buffer.append(digits, length);
+        return check_full();
+    }
+
+    OutputBuffer &operator<<(FixedPoint number) {
+        char digits[48];
+        size_t length = format_fixed(number.value, number.precision, digits);
+        buffer.append(digits, length);
+        return check_full();
+    }
+
+    // Write count copies of c, used for padding and separators
+    inline OutputBuffer &repeat(char c, size_t count) {
+        buffer.append(count, c);
+        return check_full();
+    }
+
+    // Write integer to digits, which must hold 24 characters, and return its length
+    template <typename T>
+    static size_t format_integer(T value, char *digits) {
+        char reversed[24];
+        size_t length = 0;
+        bool negative = false;
+        unsigned long long magnitude = (unsigned long long)value;
+        if (std::is_signed<T>::value && value < 0) {
+            negative = true;
+            magnitude = 0ull - magnitude;
+        }
+        do {
+            reversed[length++] = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        size_t position = 0;
+        if (negative) {
+            digits[position++] = '-';
+        }
+        while (length > 0) {
+            digits[position++] = reversed[--length];
+        }
+        return position;
+    }
+
+    // Write value with precision digits after the point to digits, which must hold 48 characters, and return its length
+    static size_t format_fixed(double value, int precision, char *digits) {
+        static const double scales[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+        precision = std::max(0, std::min(precision, 9));
+        double magnitude = std::fabs(value);
+        if (!std::isfinite(value) || magnitude * scales[precision] >= 1e18) {
+            // Out of the range of integer formatting
+            int length = snprintf(digits, 48, "%.*f", precision, value);
+            return (size_t)std::max(0, std::min(length, 47));
+        }
+        unsigned long long scale = (unsigned long long)scales[precision];
+        unsigned long long scaled = (unsigned long long)(magnitude * scales[precision] + 0.5);
+        size_t position = 0;
+        if (std::signbit(value)) {
+            digits[position++] = '-';
+        }
+        position += format_integer(scaled / scale, digits + position);
+        if (precision > 0) {
+            digits[position++] = '.';
+            unsigned long long fraction = scaled % scale;
+            for (int i = precision - 1; i >= 0; i--) {
+                digits[position + i] = (char)('0' + fraction % 10);
+                fraction /= 10;
+            }
+            position += precision;
+        }
+        return position;
+    }
+
+   private:
+    inline bool is_bound() const {
+#if defined(CORETEST_HAS_FORK)
+        return descriptor != -1;
+#else
+        return file != nullptr;
+#endif
+    }
+
+    inline OutputBuffer &check_full() {
+        if (buffer.size() >= chunk_size && is_bound()) {
+            flush();
+        }
+        return *this;
+    }
+
+    std::string buffer;
+#if defined(CORETEST_HAS_FORK)
+    int descriptor = -1;
+#else
+    FILE *file = nullptr;
+#endif
+    bool owns_file = false;
+};
+
+// Output of a test case as it is being reported
+struct TestOutput {
+    TestOutput(OutputBuffer &new_out, const Test &new_test, size_t new_index) : out(new_out), test(new_test), index(new_index) {}
+
+    OutputBuffer &out;
+    const Test &test;
+    // Position of the test case in the run
+    size_t index;
+    // Set by reporters that write the test case header on its first event
+    bool header_written = false;
+    // Held by reporters that can only write a test case once it has ended
+    OutputBuffer pending;
+};
+
+// Assertion state of the test case running on a thread
+struct TestContext {
+    TestResult result;
+    AssertionLog log;
+    // Assertion events are reported to output while a test case runs
+    TestOutput *output = nullptr;
+    // Allocations of this thread are counted into result
+    bool count_allocations = false;
+    // Blocks allocated by the test case and freed by other threads, folded into result when the test case ends
+    std::atomic<size_t> remote_frees{0};
+    std::atomic<int64_t> remote_freed_bytes{0};
+    // Passed assertions are counted inline, set while a test case runs without --success
+    bool count_passed_inline = false;
+    // Run of the test case, assertions of other threads made during it are merged into it
+    uint64_t run = 0;
+    // Assertions counted on the thread running the test case, read by the watchdog and folded into result when it ends
+    std::atomic<size_t> assertions_run{0};
+    // Last logged assertion for the watchdog, written under a sequence number that is odd while it changes
+    // Its operands point into log, whose text stays in place until the log is cleared
+    std::atomic<uint64_t> last_logged_sequence{0};
+    std::atomic<uint64_t> last_logged_fields{0};
+    std::atomic<const char *> last_first{nullptr};
+    std::atomic<size_t> last_first_size{0};
+    std::atomic<const char *> last_second{nullptr};
+    std::atomic<size_t> last_second_size{0};
+    PerfCounterGroup perf;
+};
+
+// Increment counter that only the current thread writes, which needs no read-modify-write
+inline void increment_owned(std::atomic<size_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Outcome of a test case, held until it is printed in registration order
+struct TestReport {
+    TestResult result;
+    TestTiming timing;
+    BenchmarkStatistics benchmark;
+    StressStatistics stress;
+    // Sampled if a baseline is saved or compared
+    DurationStatistics durations;
+    BaselineChange baseline_change = BaselineChange::NONE;
+    double baseline_median = 0;
+    std::string output;
+    // Test case ended its process before finishing
+    bool crashed = false;
+    // Test case was started, test cases are not started once --max-failures is reached
+    bool ran = false;
+};
+
+// Counts of a whole run
+struct RunTotals {
+    size_t tests = 0;
+    size_t tests_failed = 0;
+    size_t assertions = 0;
+    size_t assertions_failed = 0;
+    // Selected test cases that were not started because --max-failures was reached
+    size_t tests_not_run = 0;
+    // Failed assertions of threads made while no single test case was running, included in assertions_failed
+    size_t assertions_failed_unattributed = 0;
+};
+
+// Receives events of a run as they happen
+// Output is flushed after each event, except for passed assertions which are flushed with their test case
+// Failed assertions and failures outside of assertions are only reported between test_started and test_ended
+class Reporter {
+   public:
+    virtual ~Reporter() = default;
+    virtual void run_started(OutputBuffer &out, size_t test_count) = 0;
+    virtual void test_started(TestOutput &output) = 0;
+    virtual void assertion(TestOutput &output, const Assertion &assertion) = 0;
+    // Failure not caused by an assertion, such as a leak or a crash
+    virtual void failure(TestOutput &output, const std::string &message) = 0;
+    virtual void test_ended(TestOutput &output, const TestReport &report) = 0;
+    virtual void run_ended(OutputBuffer &out, const RunTotals &totals) = 0;
+};
+
+const int separator_length = 80;
+// Holds counters and logged assertions of the test case running on this thread
+extern thread_local TestContext *current_context;
+// Passed assertions are logged if --success is given
+extern bool show_successful;
+
+// Log formatted assertion and throw if a require has failed, unless exceptions are disabled
+void record_assertion(bool passed, AssertionType type, ComparisonType comparison, const std::string &first, const std::string &second, bool expression = false);
+// Parse command line arguments and run the selected test cases, returns the exit status of the test executable
+int run_main(int argc, char **argv);
+// Return index of the TEST_CONCURRENT thread running the caller, 0 on other threads
+int get_thread_index();
+
+#if defined(CORETEST_IMPLEMENTATION)
+// Holds all registered tests
+TestRegistry registry;
+// Holds tests selected to run, in the order they are run
+std::vector<const Test *> tests;
+// Holds user specifed tests to run
+std::vector<std::string> specified_tests;
+// Context of the main thread, also used for assertions outside of test cases
+TestContext main_context;
+// Shared context of threads that do not run test cases, such as workers started by the code under test
+// It is never written, assertions of these threads go to their own buffer instead
+TestContext foreign_context;
+thread_local TestContext *current_context = &foreign_context;
+
+// Points the main thread at its own context during static initialization, which runs on the main thread
+struct MainThreadContext {
+    MainThreadContext() {
+        current_context = &main_context;
+    }
+} main_thread_context;
+// Maximum number of assertions logged per test case, 0 for no limit
+size_t assertion_log_limit = 1024;
+// Number of threads running test cases
+size_t jobs = 1;
+// Holds report of each test case run, in registration order
+std::vector<TestReport> reports;
+// Reporter selected with --reporter
+std::unique_ptr<Reporter> reporter;
+// Reporter output, written to stdout or the file given with --out
+OutputBuffer report_output;
+
+Test::Test(void (*new_function)(), const char *new_test_name, const char *new_file_name, int new_line_number, const char *new_tags, bool new_serial, bool new_benchmark, int64_t new_timeout, size_t new_threads)
+    : function(new_function), test_name(new_test_name), file_name(new_file_name), line_number(new_line_number), tags(new_tags), serial(new_serial), benchmark(new_benchmark), timeout(new_timeout), threads(new_threads) {
+    if (registry.last == nullptr) {
+        registry.first = this;
+    } else {
+        registry.last->next = this;
+    }
+    registry.last = this;
+    registry.size++;
+}
+#endif
+
+// Return user and system CPU time of the calling thread in nanoseconds
+inline void get_cpu_time(int64_t &user, int64_t &system) {
+#if defined(CORETEST_HAS_FORK)
+    rusage usage;
+#if defined(RUSAGE_THREAD)
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    user = (int64_t)usage.ru_utime.tv_sec * 1000000000 + (int64_t)usage.ru_utime.tv_usec * 1000;
+    system = (int64_t)usage.ru_stime.tv_sec * 1000000000 + (int64_t)usage.ru_stime.tv_usec * 1000;
+#else
+    user = 0;
+    system = 0;
+#endif
+}
+
+// Records wall and CPU time from construction until destruction into timing
+// Also records when the test case ends with an exception
+// Counts allocations of the current thread while in scope
+class CountAllocations {
+   public:
+    CountAllocations(TestContext &new_context) : context(new_context) {
+        context.count_allocations = true;
+    }
+
+    ~CountAllocations() {
+        context.count_allocations = false;
+    }
+
+   private:
+    TestContext &context;
+};
+
+// Stops counting allocations of the current thread while in scope, used for allocations made by the runner
+class AllocationPause {
+   public:
+    AllocationPause() : context(*current_context), previous(context.count_allocations) {
+        // Contexts that are not counting are left unwritten, as threads not running a test case share one
+        if (previous) {
+            context.count_allocations = false;
+        }
+    }
+
+    ~AllocationPause() {
+        if (previous) {
+            context.count_allocations = true;
+        }
+    }
+
+   private:
+    TestContext &context;
+    bool previous;
+};
+
+class Timer {
+   public:
+    Timer(TestTiming &new_timing) : timing(new_timing) {
+        get_cpu_time(start_user, start_system);
+        start_timepoint = std::chrono::steady_clock::now();
+    }
+
+    ~Timer() {
+        stop();
+    }
+
+    void stop() {
+        timing.wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_timepoint).count();
+        int64_t user;
+        int64_t system;
+        get_cpu_time(user, system);
+        timing.user = user - start_user;
+        timing.system = system - start_system;
+    }
+
+   private:
+    TestTiming &timing;
+    int64_t start_user;
+    int64_t start_system;
+    std::chrono::steady_clock::time_point start_timepoint;
+};
+
+// Call function, which runs a test case that a failed require ends early
+// Without exceptions the require has already returned from the test function
+template <typename Function>
+inline void run_until_failed_require(const Function &function) {
+#if defined(CORETEST_NO_EXCEPTIONS)
+    function();
+#else
+    try {
+        function();
+    } catch (CoreTestError &) {
+        // Failure is held in the context of the test case
+    }
+#endif
+}
+
+#if defined(CORETEST_IMPLEMENTATION)
+// Timeouts
+
+// Return steady clock time in nanoseconds, which is comparable between processes on the same machine
+inline int64_t get_steady_time() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Test case running on a runner thread, polled by the watchdog
+struct WatchdogSlot {
+    std::atomic<const Test *> test{nullptr};
+    // Steady time the test case started at, 0 if the thread is not running a test case
+    std::atomic<int64_t> start{0};
+    TestContext *context = nullptr;
+};
+
+// Slot of the current thread, nullptr if no watchdog is running
+thread_local WatchdogSlot *current_slot = nullptr;
+
+// Publishes the test case run in its scope to the watchdog, which is two stores and no synchronization
+class WatchScope {
+   public:
+    WatchScope(const Test &test) {
+        if (current_slot != nullptr) {
+            current_slot->test.store(&test, std::memory_order_relaxed);
+            current_slot->start.store(get_steady_time(), std::memory_order_release);
+        }
+    }
+
+    ~WatchScope() {
+        if (current_slot != nullptr) {
+            current_slot->start.store(0, std::memory_order_release);
+        }
+    }
+};
+#endif
+
+// Benchmarks
+
+// Minimum duration of a single benchmark sample
+const std::chrono::nanoseconds benchmark_sample_time = std::chrono::milliseconds(10);
+// Number of samples taken of each benchmark
+const size_t benchmark_samples = 20;
+
+// Prevent the compiler from optimizing away the computation of value
+template <typename T>
+inline void do_not_optimize(T const &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile char *pointer = reinterpret_cast<const volatile char *>(&value);
+    (void)*pointer;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Prevent the compiler from reordering or eliding memory writes across this point
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Return duration of iterations calls to function in nanoseconds
+// Allocations of the calls are counted, those of the runner between samples are not
+inline double time_iterations(void (*function)(), size_t iterations) {
+    CountAllocations counting(*current_context);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        function();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Return median of sorted samples
+inline double get_median(const std::vector<double> &samples) {
+    size_t middle = samples.size() / 2;
+    return (samples.size() % 2 == 0) ? (samples[middle - 1] + samples[middle]) / 2 : samples[middle];
+}
+
+#if defined(CORETEST_IMPLEMENTATION)
+// Scale iterations until a sample reaches benchmark_sample_time, then take benchmark_samples samples
+BenchmarkStatistics measure_benchmark(void (*function)()) {
+    const double target = (double)benchmark_sample_time.count();
+    size_t iterations = 1;
+    while (true) {
+        double elapsed = time_iterations(function, iterations);
+        if (elapsed >= target) {
+            break;
+        }
+        // Grow by the estimated factor, at least doubling and at most by 10x per step
+        double factor = elapsed > 0 ? (target * 1.2) / elapsed : 10;
+        iterations = (size_t)(iterations * std::min(10.0, std::max(2.0, factor)));
+    }
+    std::vector<double> samples;
+    samples.reserve(benchmark_samples);
+    PerfCounterGroup &perf = current_context->perf;
+    PerfCounts perf_start = perf.read();
+    for (size_t i = 0; i < benchmark_samples; i++) {
+        samples.push_back(time_iterations(function, iterations) / iterations);
+    }
+    BenchmarkStatistics statistics;
+    if (perf.is_running()) {
+        statistics.perf = perf.read() - perf_start;
+    }
+    std::sort(samples.begin(), samples.end());
+    statistics.iterations = iterations;
+    statistics.samples = samples.size();
+    for (double sample : samples) {
+        statistics.mean += sample;
+    }
+    statistics.mean /= samples.size();
+    statistics.median = get_median(samples);
+    for (double sample : samples) {
+        statistics.stddev += (sample - statistics.mean) * (sample - statistics.mean);
+    }
+    statistics.stddev = samples.size() > 1 ? sqrt(statistics.stddev / (samples.size() - 1)) : 0;
+    statistics.min = samples.front();
+    return statistics;
+}
+
+// Baselines
+
+// Minimum number of runs of each test case when its duration is sampled for a baseline
+const size_t baseline_min_samples = 5;
+// Test cases are run until their runs take at least this long, if they have not reached baseline_max_samples
+const std::chrono::nanoseconds baseline_sample_time = std::chrono::milliseconds(100);
+const size_t baseline_max_samples = 1000;
+// Differences of medians smaller than this many standard errors are treated as noise
+const double baseline_significance = 3;
+
+// Duration statistics of test cases per machine, read from and written to baseline files
+// A file starts with a version line, followed by sections of entries for each machine:
+//     coretest-baseline 1
+//     machine <machine name>
+//     <samples> <median ns> <deviation ns> <min ns> <test name>
+// Files are merged by concatenating them, later entries replace earlier ones of the same machine and test case
+class Baseline {
+   public:
+    static const int version = 1;
+
+    // Add entries of file, returns false if the file can not be opened
+    bool read(const std::string &file_name) {
+        std::ifstream file(file_name);
+        if (!file) {
+            return false;
+        }
+        std::string line;
+        std::map<std::string, DurationStatistics> *entries = nullptr;
+        size_t line_number = 0;
+        while (std::getline(file, line)) {
+            line_number++;
+            std::istringstream fields(line);
+            std::string first;
+            if (!(fields >> first) || first[0] == '#') {
+                continue;
+            } else if (first == "coretest-baseline") {
+                int file_version = 0;
+                if (!(fields >> file_version) || file_version != version) {
+                    raise_error("Unsupported baseline version in " + file_name + ": " + line);
+                }
+                continue;
+            } else if (first == "machine") {
+                std::string name;
+                std::getline(fields >> std::ws, name);
+                entries = &machines[name];
+                continue;
+            }
+            DurationStatistics statistics;
+            std::string test_name;
+            fields.clear();
+            fields.seekg(0);
+            if (entries == nullptr || !(fields >> statistics.samples >> statistics.median >> statistics.deviation >> statistics.min >> test_name)) {
+                raise_error("Invalid baseline entry in " + file_name + ":" + std::to_string(line_number) + ": " + line);
+            }
+            (*entries)[test_name] = statistics;
+        }
+        return true;
+    }
+
+    // Returns false if the file can not be written
+    bool write(const std::string &file_name) const {
+        OutputBuffer out;
+        if (!out.open_file(file_name)) {
+            return false;
+        }
+        out << "coretest-baseline " << version << '\n';
+        for (const auto &machine : machines) {
+            out << "machine " << machine.first << '\n';
+            for (const auto &entry : machine.second) {
+                const DurationStatistics &statistics = entry.second;
+                out << statistics.samples << ' ' << FixedPoint{statistics.median, 1} << ' ' << FixedPoint{statistics.deviation, 1}
+                    << ' ' << FixedPoint{statistics.min, 1} << ' ' << entry.first << '\n';
+            }
+        }
+        return true;
+    }
+
+    // Return entry of a test case measured on machine, nullptr if there is none
+    const DurationStatistics *find(const std::string &machine, const std::string &test_name) const {
+        auto found_machine = machines.find(machine);
+        if (found_machine == machines.end()) {
+            return nullptr;
+        }
+        auto found = found_machine->second.find(test_name);
+        return found == found_machine->second.end() ? nullptr : &found->second;
+    }
+
+    inline void set(const std::string &machine, const std::string &test_name, const DurationStatistics &statistics) {
+        machines[machine][test_name] = statistics;
+    }
+
+   private:
+    // Sorted so that files are stable and can be diffed
+    std::map<std::string, std::map<std::string, DurationStatistics>> machines;
+};
+
+// Outcome of a test case in the last run it was selected in
+struct TestState {
+    bool failed = false;
+    int64_t duration = 0;
+};
+
+// Last outcome and duration of each test case by name, used to schedule the next run
+// The file is only a cache, so a missing, outdated or damaged file is ignored rather than reported
+class RunState {
+   public:
+    static const int version = 1;
+
+    void read(const std::string &file_name) {
+        std::ifstream file(file_name);
+        std::string line;
+        if (!std::getline(file, line) || line != "coretest-state " + std::to_string(version)) {
+            return;
+        }
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string outcome;
+            TestState state;
+            std::string test_name;
+            if (fields >> outcome >> state.duration >> test_name && (outcome == "passed" || outcome == "failed")) {
+                state.failed = outcome == "failed";
+                entries[test_name] = state;
+            }
+        }
+    }
+
+    // Merge test cases set in this run into the file, keeping entries of other test cases as they are in the file
+    // Processes that run test cases of one executable at once, such as under CTest, are serialized by a lock file
+    // so that none of their entries are lost, and the merged state replaces the file through a temporary file
+    // so that a run which is killed leaves the previous state
+    bool write(const std::string &file_name) const {
+#if defined(CORETEST_HAS_FORK)
+        int lock = ::open((file_name + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (lock == -1) {
+            return false;
+        }
+        flock(lock, LOCK_EX);
+#endif
+        RunState merged;
+        merged.read(file_name);
+        for (const auto &entry : updates) {
+            merged.entries[entry.first] = entry.second;
+        }
+        std::string temporary_name = file_name + ".tmp";
+        bool written = false;
+        {
+            OutputBuffer out;
+            if (out.open_file(temporary_name)) {
+                out << "coretest-state " << version << '\n';
+                for (const auto &entry : merged.entries) {
+                    out << (entry.second.failed ? "failed " : "passed ") << entry.second.duration << ' ' << entry.first << '\n';
+                }
+                written = true;
+            }
+        }
+        written = written && std::rename(temporary_name.c_str(), file_name.c_str()) == 0;
+#if defined(CORETEST_HAS_FORK)
+        // Closing releases the lock
+        ::close(lock);
+#endif
+        return written;
+    }
+
+    // Return state of a test case in the file that was read, nullptr if it has not run before
+    const TestState *find(const std::string &test_name) const {
+        auto found = entries.find(test_name);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    // Record state of a test case in this run, written by write
+    inline void set(const std::string &test_name, const TestState &state) {
+        updates[test_name] = state;
+    }
+
+   private:
+    // Sorted so that files are stable and can be diffed
+    std::map<std::string, TestState> entries;
+    std::map<std::string, TestState> updates;
+};
+
+// Return name of the machine used to key baselines, durations are only compared between equal machines
+// Machines are identified by CPU model and number of hardware threads rather than host name, so that CI runners of one type share baselines
+std::string get_machine_name() {
+    std::string model;
+#if defined(__linux__)
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0 && line.find(':') != std::string::npos) {
+            model = line.substr(line.find(':') + 1);
+            model.erase(0, model.find_first_not_of(" \t"));
+            break;
+        }
+    }
+#endif
+    if (model.empty()) {
+        model = "unknown";
+    }
+    return model + " x" + std::to_string(std::thread::hardware_concurrency());
+}
+
+// Move assertions made on threads not running a test case into context
+void merge_thread_assertions(TestContext &context);
+
+// Publish assertion as the last logged one of context, fields of 0 mean that none was logged
+// Only the thread running the test case writes, so the sequence number needs no read-modify-write
+void publish_last_logged(TestContext &context, uint64_t fields, std::string_view first, std::string_view second) {
+    uint64_t sequence = context.last_logged_sequence.load(std::memory_order_relaxed);
+    context.last_logged_sequence.store(sequence + 1, std::memory_order_relaxed);
+    // Release stores, so that a reader seeing any new field also sees the odd sequence number
+    context.last_logged_fields.store(fields, std::memory_order_release);
+    context.last_first.store(first.data(), std::memory_order_release);
+    context.last_first_size.store(first.size(), std::memory_order_release);
+    context.last_second.store(second.data(), std::memory_order_release);
+    context.last_second_size.store(second.size(), std::memory_order_release);
+    context.last_logged_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Forget the last logged assertion of context before a test case runs and its log is cleared
+void clear_last_logged(TestContext &context) {
+    publish_last_logged(context, 0, std::string_view(), std::string_view());
+}
+
+// Run test case again until its duration has been sampled enough, and return statistics of all runs
+// first_wall is the duration of the run that was reported, the other runs are not reported
+DurationStatistics sample_durations(const Test &test, int64_t first_wall) {
+    TestContext &context = *current_context;
+    std::vector<double> samples = {(double)first_wall};
+    double total = (double)first_wall;
+    while (samples.size() < baseline_max_samples && (samples.size() < baseline_min_samples || total < baseline_sample_time.count())) {
+        context.result = TestResult();
+        context.assertions_run.store(0, std::memory_order_relaxed);
+        clear_last_logged(context);
+        context.log.clear(assertion_log_limit);
+        TestTiming timing;
+        // Failures of runs that are only timed are not reported
+        run_until_failed_require([&] {
+            Timer timer(timing);
+            WatchScope watch(test);
+            test.function();
+        });
+        merge_thread_assertions(context);
+        samples.push_back((double)timing.wall);
+        total += timing.wall;
+    }
+    std::sort(samples.begin(), samples.end());
+    DurationStatistics statistics;
+    statistics.samples = samples.size();
+    statistics.median = get_median(samples);
+    std::vector<double> deviations;
+    for (double sample : samples) {
+        deviations.push_back(std::fabs(sample - statistics.median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    // Scaled so that the median absolute deviation estimates the standard deviation of normally distributed samples
+    statistics.deviation = 1.4826 * get_median(deviations);
+    statistics.min = samples.front();
+    return statistics;
+}
+
+// Return if the medians of two sets of samples differ by more than noise
+inline bool is_significant(const DurationStatistics &first, const DurationStatistics &second) {
+    // Standard error of a median is about 1.253 times that of a mean
+    double first_error = 1.253 * first.deviation / std::sqrt((double)std::max<size_t>(first.samples, 1));
+    double second_error = 1.253 * second.deviation / std::sqrt((double)std::max<size_t>(second.samples, 1));
+    return std::fabs(first.median - second.median) > baseline_significance * std::sqrt(first_error * first_error + second_error * second_error);
+}
+
+// Command line option
+class Option {
+   public:
+    Option(bool &ref) : option_reference(ref) {}
+
+    inline auto &operator[](const std::string name) {
+        args.push_back(name);
+        return *this;
+    }
+
+    inline auto &operator()(std::string new_description, std::string new_name) {
+        description = new_description;
+        name = new_name;
+        return *this;
+    }
+
+    bool is_match(const std::string &argument) {
+        for (const std::string &arg : args) {
+            if (argument == arg) {
+                option_reference = true;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline const std::vector<std::string> &get_args() const {
+        return args;
+    }
+
+    inline const std::string &get_description() const {
+        return description;
+    }
+
+    inline void set_require_argument(bool require) {
+        require_argument = require;
+    }
+
+    inline bool get_require_argument() {
+        return require_argument;
+    }
+
+    inline void set_argument(std::string new_argument) {
+        argument = new_argument;
+    }
+
+    inline const std::string &get_argument() const {
+        return argument;
+    }
+
+    inline const std::string &get_name() const {
+        return name;
+    }
+
+   private:
+    bool &option_reference;
+    bool require_argument = false;
+    std::vector<std::string> args;
+    std::string description;
+    std::string argument;
+    std::string name;
+};
+
+// Glob pattern where * matches any characters and ? matches one character
+// Patterns without wildcards or with only a leading or trailing * are matched without backtracking
+class Pattern {
+   public:
+    Pattern(std::string new_text) : text(new_text) {
+        size_t stars = std::count(text.begin(), text.end(), '*');
+        bool has_question = text.find('?') != std::string::npos;
+        if (text == "*") {
+            kind = Kind::ANY;
+        } else if (has_question || stars > 2) {
+            kind = Kind::GLOB;
+        } else if (stars == 0) {
+            kind = Kind::EXACT;
+        } else if (stars == 1 && text.back() == '*') {
+            kind = Kind::PREFIX;
+            text.pop_back();
+        } else if (stars == 1 && text.front() == '*') {
+            kind = Kind::SUFFIX;
+            text.erase(0, 1);
+        } else if (stars == 2 && text.front() == '*' && text.back() == '*') {
+            kind = Kind::CONTAINS;
+            text = text.substr(1, text.length() - 2);
+        } else {
+            kind = Kind::GLOB;
+        }
+    }
+
+    bool matches(std::string_view value) const {
+        switch (kind) {
+            case Kind::ANY:
+                return true;
+            case Kind::EXACT:
+                return value == text;
+            case Kind::PREFIX:
+                return value.substr(0, text.length()) == text;
+            case Kind::SUFFIX:
+                return value.length() >= text.length() && value.substr(value.length() - text.length()) == text;
+            case Kind::CONTAINS:
+                return value.find(text) != std::string_view::npos;
+            case Kind::GLOB:
+                return matches_glob(value);
+        }
+        return false;
+    }
+
+   private:
+    enum class Kind {
+        ANY,
+        EXACT,
+        PREFIX,
+        SUFFIX,
+        CONTAINS,
+        GLOB
+    };
+
+    bool matches_glob(std::string_view value) const {
+        size_t t = 0;
+        size_t v = 0;
+        // Position after the last * and the value position it was matched at
+        size_t star = std::string::npos;
+        size_t star_value = 0;
+        while (v < value.length()) {
+            if (t < text.length() && (text[t] == '?' || text[t] == value[v])) {
+                t++;
+                v++;
+            } else if (t < text.length() && text[t] == '*') {
+                star = ++t;
+                star_value = v;
+            } else if (star != std::string::npos) {
+                t = star;
+                v = ++star_value;
+            } else {
+                return false;
+            }
+        }
+        while (t < text.length() && text[t] == '*') {
+            t++;
+        }
+        return t == text.length();
+    }
+
+    Kind kind;
+    std::string text;
+};
+
+// Test filter expression compiled into groups of terms
+// Terms separated by whitespace must all match, groups separated by ',' are alternatives
+// A term is a test name pattern or a [tag] pattern, and a leading ~ excludes matching test cases
+class TestFilter {
+   public:
+    TestFilter() {}
+
+    TestFilter(const std::string &expression) {
+        groups.emplace_back();
+        size_t i = 0;
+        while (i < expression.length()) {
+            char c = expression[i];
+            if (c == ' ' || c == '\t') {
+                i++;
+                continue;
+            }
+            if (c == ',') {
+                groups.emplace_back();
+                i++;
+                continue;
+            }
+            bool negated = false;
+            if (c == '~') {
+                negated = true;
+                i++;
+            }
+            if (i < expression.length() && expression[i] == '[') {
+                size_t end = expression.find(']', i);
+                if (end == std::string::npos) {
+                    raise_error("Unterminated tag in filter: " + expression);
+                }
+                groups.back().push_back({Pattern(expression.substr(i + 1, end - i - 1)), true, negated});
+                i = end + 1;
+            } else {
+                size_t end = expression.find_first_of(" \t,[", i);
+                if (end == std::string::npos) {
+                    end = expression.length();
+                }
+                if (end == i) {
+                    raise_error("Expected test name or tag in filter: " + expression);
+                }
+                groups.back().push_back({Pattern(expression.substr(i, end - i)), false, negated});
+                i = end;
+            }
+        }
+        for (const std::vector<Term> &group : groups) {
+            if (group.empty()) {
+                raise_error("Empty alternative in filter: " + expression);
+            }
+        }
+    }
+
+    inline bool is_empty() const {
+        return groups.empty();
+    }
+
+    bool matches(const Test &test) const {
+        if (groups.empty()) {
+            return true;
+        }
+        for (const std::vector<Term> &group : groups) {
+            bool group_matches = true;
+            for (const Term &term : group) {
+                bool term_matches = term.is_tag ? matches_tag(term.pattern, test.tags) : term.pattern.matches(test.test_name);
+                if (term_matches == term.negated) {
+                    group_matches = false;
+                    break;
+                }
+            }
+            if (group_matches) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+   private:
+    struct Term {
+        Pattern pattern;
+        bool is_tag;
+        bool negated;
+    };
+
+    // Return if any tag in tags of the form "[tag1][tag2]" matches pattern
+    static bool matches_tag(const Pattern &pattern, std::string_view tags) {
+        size_t start = tags.find('[');
+        while (start != std::string_view::npos) {
+            size_t end = tags.find(']', start);
+            if (end == std::string_view::npos) {
+                break;
+            }
+            if (pattern.matches(tags.substr(start + 1, end - start - 1))) {
+                return true;
+            }
+            start = tags.find('[', end);
+        }
+        return false;
+    }
+
+    std::vector<std::vector<Term>> groups;
+};
+
+class TestCaseOption {
+   public:
+    TestCaseOption() {}
+    bool is_match(std::string argument) {
+        if (argument[0] == '[' && argument[argument.length() - 1] == ']') {
+            // Get test name without [ ] chars
+            std::string test_name = argument.substr(1, argument.length() - 2);
+            // Remove whitespace
+            test_name.erase(std::remove(test_name.begin(), test_name.end(), ' '), test_name.end());
+            specified_tests.push_back(test_name);
+            return true;
+        }
+        return false;
+    }
+};
+
+// Declare test case command line argument
+TestCaseOption test_case_option;
+
+// Holds command line argument options
+std::unordered_map<std::string, Option> options_unordered_map;
+bool show_successful = false;
+bool show_list = false;
+bool set_list_format = false;
+// Format of --list-tests, text or json
+std::string list_format = "text";
+bool show_help = false;
+bool send_to_file = false;
+bool silence_output = false;
+bool show_durations = false;
+bool set_log_limit = false;
+bool set_jobs = false;
+bool isolate = false;
+bool run_benchmarks = false;
+bool check_leaks = false;
+bool use_perf_counters = false;
+bool set_filter = false;
+bool set_reporter = false;
+// Compiled filter expression given with --filter
+TestFilter test_filter;
+bool save_baseline = false;
+bool compare_baseline = false;
+bool set_max_regression = false;
+bool set_timeout = false;
+// Timeout of test cases in milliseconds given with --timeout, 0 for none
+int64_t timeout = 0;
+bool set_stress_threads = false;
+// Number of threads running the body of every selected test case given with --stress-threads, 0 if not given
+size_t stress_threads = 0;
+bool set_stress_rounds = false;
+// Number of rounds a concurrent test case runs for, unless --stress-time is given
+size_t stress_rounds = 100;
+bool set_stress_time = false;
+// Time a concurrent test case repeats rounds for in milliseconds given with --stress-time, 0 for none
+int64_t stress_time = 0;
+bool set_repeat = false;
+// Number of passes over the selected test cases given with --repeat
+size_t repeat_count = 1;
+bool until_fail = false;
+bool set_soak = false;
+// Time passes are repeated for in nanoseconds given with --soak, 0 for none
+int64_t soak_duration = 0;
+
+// Durations and failures of a test case over all passes of a repeated run
+struct RepeatHistory {
+    DurationHistogram durations;
+    size_t failures = 0;
+};
+
+// History of each selected test case, only filled if test cases are repeated
+std::vector<RepeatHistory> histories;
+// Number of passes over the selected test cases and their wall time in nanoseconds
+size_t passes = 0;
+int64_t passes_wall = 0;
+
+bool set_state_file = false;
+// Run-state file, given with --state-file or the path of the executable followed by .coretest-state
+// Empty unless an option uses it, so that plain runs do not write next to the executable
+std::string state_file_name;
+// Outcomes of the previous runs, read from the run-state file
+RunState run_state;
+bool failed_first = false;
+bool rerun_failed = false;
+bool set_order = false;
+// Order of test cases given with --order: declared, slowest-first, fastest-first or random:<seed>
+std::string test_order = "declared";
+// Seed of --order random:<seed>
+uint64_t order_seed = 0;
+bool fail_fast = false;
+bool set_max_failures = false;
+// Number of failed test case runs after which no more test cases are started, 0 for no limit
+size_t max_failures = 0;
+// Failed test case runs of this run, counted by the threads and processes running them
+std::atomic<size_t> failed_runs{0};
+
+bool set_shard_index = false;
+bool set_shard_count = false;
+bool set_shard_timings = false;
+// Shard of the selected test cases run by this process, given with --shard-index and --shard-count
+size_t shard_index = 0;
+size_t shard_count = 1;
+// Durations that balance shards, read from the run-state file given with --shard-timings
+RunState shard_timings;
+
+// Return if enough test cases have failed that no more are started
+inline bool reached_max_failures() {
+    return max_failures > 0 && failed_runs.load(std::memory_order_relaxed) >= max_failures;
+}
+
+// Return if the selected test cases are run more than once
+inline bool is_repeating() {
+    return set_repeat || until_fail || soak_duration > 0;
+}
+// Baseline given with --compare-baseline
+Baseline baseline;
+// Name of this machine in baselines, only set if a baseline is saved or compared
+std::string machine_name;
+// Slowdown of a median above which a test case fails when compared with its baseline
+double max_regression = 0.2;
+
+template <typename First, typename... Rest>
+void add_options(First first, Rest... rest) {
+    add_options(first);
+    add_options(rest...);
+}
+
+template <>
+void add_options(Option option) {
+    options_unordered_map.insert(std::make_pair(option.get_name(), option));
+}
+
+// Initialize options
+void initialize_options() {
+    Option help(show_help);
+    help["-?"]["-h"]["--help"]("display usage information", "help");
+    Option list(show_list);
+    list["-l"]["--list-tests"]["--list"]("list all test cases", "list");
+    Option list_format_option(set_list_format);
+    list_format_option["--format"]("format of --list-tests: text or json", "list_format");
+    list_format_option.set_require_argument(true);
+    Option successful_tests(show_successful);
+    successful_tests["-s"]["--success"]("include successful tests in output", "successful_tests");
+    Option out(send_to_file);
+    out["-o"]["--out"]("send output to a given file", "out");
+    out.set_require_argument(true);
+    Option quiet(silence_output);
+    quiet["-q"]["--quiet"]("disable all logging", "quiet");
+    Option duration(show_durations);
+    duration["-d"]["--durations"]("show duration of each test case", "duration");
+    Option log_limit(set_log_limit);
+    log_limit["--log-limit"]("maximum number of assertions printed per test case", "log_limit");
+    log_limit.set_require_argument(true);
+    Option jobs_option(set_jobs);
+    jobs_option["-j"]["--jobs"]("number of threads running test cases, 0 for all cores", "jobs");
+    jobs_option.set_require_argument(true);
+    Option isolate_option(isolate);
+    isolate_option["--isolate"]("run test cases in worker processes that are respawned on crashes", "isolate");
+    Option benchmark_option(run_benchmarks);
+    benchmark_option["--benchmark"]("run benchmarks instead of test cases", "benchmark");
+    Option leaks_option(check_leaks);
+    leaks_option["--leaks"]("fail test cases that end with more heap memory in use than they started with", "leaks");
+    Option filter_option(set_filter);
+    filter_option["-f"]["--filter"]("run test cases matching names, [tags], ~exclusions, separated by ',' for or", "filter");
+    filter_option.set_require_argument(true);
+    Option reporter_option(set_reporter);
+    reporter_option["-r"]["--reporter"]("format of output: console, junit, jsonl or tap", "reporter");
+    reporter_option.set_require_argument(true);
+    Option save_baseline_option(save_baseline);
+    save_baseline_option["--save-baseline"]("run test cases repeatedly and save their durations to a given file", "save_baseline");
+    save_baseline_option.set_require_argument(true);
+    Option compare_baseline_option(compare_baseline);
+    compare_baseline_option["--compare-baseline"]("run test cases repeatedly and fail those slower than in a given baseline file", "compare_baseline");
+    compare_baseline_option.set_require_argument(true);
+    Option max_regression_option(set_max_regression);
+    max_regression_option["--max-regression"]("slowdown of a median that fails a test case with --compare-baseline, default 20%", "max_regression");
+    max_regression_option.set_require_argument(true);
+    Option timeout_option(set_timeout);
+    timeout_option["--timeout"]("abort the run if a test case runs longer than given milliseconds, or restart its worker with --isolate", "timeout");
+    timeout_option.set_require_argument(true);
+    Option perf_option(use_perf_counters);
+    perf_option["--perf-counters"]("count cycles, instructions, branch and cache misses of each test case", "perf_counters");
+    Option stress_threads_option(set_stress_threads);
+    stress_threads_option["--stress-threads"]("run the body of each test case on a given number of threads at once", "stress_threads");
+    stress_threads_option.set_require_argument(true);
+    Option stress_rounds_option(set_stress_rounds);
+    stress_rounds_option["--stress-rounds"]("number of rounds of concurrent test cases, default 100", "stress_rounds");
+    stress_rounds_option.set_require_argument(true);
+    Option stress_time_option(set_stress_time);
+    stress_time_option["--stress-time"]("repeat rounds of concurrent test cases for given milliseconds", "stress_time");
+    stress_time_option.set_require_argument(true);
+    Option repeat_option(set_repeat);
+    repeat_option["--repeat"]("run the selected test cases a given number of times", "repeat");
+    repeat_option.set_require_argument(true);
+    Option until_fail_option(until_fail);
+    until_fail_option["--until-fail"]("run the selected test cases repeatedly until one fails", "until_fail");
+    Option soak_option(set_soak);
+    soak_option["--soak"]("run the selected test cases repeatedly for a given duration, such as 90s, 30m or 24h", "soak");
+    soak_option.set_require_argument(true);
+    Option state_file_option(set_state_file);
+    state_file_option["--state-file"]("file keeping the last outcome and duration of each test case", "state_file");
+    state_file_option.set_require_argument(true);
+    Option failed_first_option(failed_first);
+    failed_first_option["--failed-first"]("run test cases that failed in their last run first", "failed_first");
+    Option rerun_failed_option(rerun_failed);
+    rerun_failed_option["--rerun-failed"]("run only test cases that failed in their last run", "rerun_failed");
+    Option order_option(set_order);
+    order_option["--order"]("order of test cases: declared, slowest-first, fastest-first or random:<seed>", "order");
+    order_option.set_require_argument(true);
+    Option fail_fast_option(fail_fast);
+    fail_fast_option["--fail-fast"]("start no more test cases after the first failure", "fail_fast");
+    Option max_failures_option(set_max_failures);
+    max_failures_option["--max-failures"]("start no more test cases after a given number of failures", "max_failures");
+    max_failures_option.set_require_argument(true);
+    Option shard_index_option(set_shard_index);
+    shard_index_option["--shard-index"]("index of the shard of test cases to run, from 0", "shard_index");
+    shard_index_option.set_require_argument(true);
+    Option shard_count_option(set_shard_count);
+    shard_count_option["--shard-count"]("number of shards the selected test cases are split into", "shard_count");
+    shard_count_option.set_require_argument(true);
+    Option shard_timings_option(set_shard_timings);
+    shard_timings_option["--shard-timings"]("run-state file with durations that balance shards", "shard_timings");
+    shard_timings_option.set_require_argument(true);
+    add_options(list,
+                list_format_option,
+                successful_tests,
+                help,
+                out,
+                quiet,
+                duration,
+                log_limit,
+                jobs_option,
+                isolate_option,
+                benchmark_option,
+                leaks_option,
+                perf_option,
+                filter_option,
+                reporter_option,
+                save_baseline_option,
+                compare_baseline_option,
+                max_regression_option,
+                timeout_option,
+                stress_threads_option,
+                stress_rounds_option,
+                stress_time_option,
+                repeat_option,
+                until_fail_option,
+                soak_option,
+                state_file_option,
+                failed_first_option,
+                rerun_failed_option,
+                order_option,
+                fail_fast_option,
+                max_failures_option,
+                shard_index_option,
+                shard_count_option,
+                shard_timings_option);
+}
+
+// Return number of threads running the body of a test case at once, 0 if it runs on the calling thread only
+inline size_t get_stress_threads(const Test &test) {
+    if (test.benchmark) {
+        return 0;
+    }
+    return stress_threads > 0 ? stress_threads : test.threads;
+}
+
+// Return if a test case must run alone, concurrent test cases use as many cores as they are given
+inline bool is_serial(const Test &test) {
+    return test.serial || get_stress_threads(test) > 0;
+}
+
+// Parse text holding only decimal digits into value, returns false if it holds anything else or does not fit
+bool parse_unsigned(const std::string &text, uint64_t &value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text.c_str(), nullptr, 10);
+    if (errno == ERANGE || parsed > std::numeric_limits<size_t>::max()) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// Return unsigned integer argument of option
+size_t get_count_argument(std::string option_name, std::string flag) {
+    std::string argument = options_unordered_map.at(option_name).get_argument();
+    uint64_t value;
+    if (!parse_unsigned(argument, value)) {
+        raise_error("Invalid argument for " + flag + ": " + argument);
+    }
+    return (size_t)value;
+}
+#endif
+
+// Maximum length of formatted strings and ranges, longer values are elided so that formatting a failure has bounded cost
+const size_t max_value_length = 256;
+
+template <typename T>
+struct StringMaker;
+
+template <typename T, typename = void>
+struct IsStreamable : std::false_type {};
+
+template <typename T>
+struct IsStreamable<T, std::void_t<decltype(std::declval<std::ostream &>() << std::declval<const T &>())>> : std::true_type {};
+
+template <typename T, typename = void>
+struct IsRange : std::false_type {};
+
+template <typename T>
+struct IsRange<T, std::void_t<decltype(std::begin(std::declval<const T &>())), decltype(std::end(std::declval<const T &>()))>> : std::true_type {};
+
+template <typename T, typename = void>
+struct IsTupleLike : std::false_type {};
+
+template <typename T>
+struct IsTupleLike<T, std::void_t<decltype(std::tuple_size<T>::value)>> : std::true_type {};
+
+template <typename T>
+struct IsOptional : std::false_type {};
+
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+// Return if T is formatted as text rather than as a range of characters
+template <typename T>
+constexpr bool is_string_like() {
+    using Decayed = typename std::decay<T>::type;
+    return std::is_same<Decayed, std::string>::value || std::is_same<Decayed, std::string_view>::value ||
+           std::is_same<Decayed, const char *>::value || std::is_same<Decayed, char *>::value;
+}
+
+// Return text truncated to max_value_length
+inline std::string elide_text(std::string_view text) {
+    if (text.size() <= max_value_length) {
+        return std::string(text);
+    }
+    return std::string(text.substr(0, max_value_length)) + "... " + std::to_string(text.size() - max_value_length) + " more characters";
+}
+
+// Return elements from begin to end formatted as {a, b, ... n more}, stopping once the text reaches max_value_length
+template <typename Iterator>
+std::string format_elements(Iterator begin, Iterator end) {
+    using Element = typename std::decay<decltype(*begin)>::type;
+    std::string text = "{";
+    for (Iterator it = begin; it != end; ++it) {
+        if (it != begin) {
+            text += ", ";
+        }
+        if (text.size() >= max_value_length) {
+            text += "... " + std::to_string(std::distance(it, end)) + " more";
+            break;
+        }
+        text += StringMaker<Element>::convert(*it);
+    }
+    return text + "}";
+}
+
+// Formats values for assertion output, specialize StringMaker for a user type with a static convert function
+// Numbers, strings, pointers, optionals, streamable types, enums, ranges and tuples are formatted by default
+template <typename T>
+struct StringMaker {
+    static std::string convert(const T &value) {
+        if constexpr (std::is_same<T, bool>::value) {
+            return value ? "true" : "false";
+        } else if constexpr (std::is_same<T, char>::value) {
+            return std::string("'") + value + "'";
+        } else if constexpr (std::is_arithmetic<T>::value) {
+            return std::to_string(value);
+        } else if constexpr (is_string_like<T>()) {
+            if constexpr (std::is_pointer<T>::value) {
+                if (value == nullptr) {
+                    return "nullptr";
+                }
+            }
+            return "\"" + elide_text(value) + "\"";
+        } else if constexpr (std::is_same<T, std::nullptr_t>::value) {
+            return "nullptr";
+        } else if constexpr (std::is_pointer<T>::value) {
+            if (value == nullptr) {
+                return "nullptr";
+            }
+            char text[32];
+            snprintf(text, sizeof(text), "%p", static_cast<const void *>(value));
+            return text;
+        } else if constexpr (IsOptional<T>::value) {
+            return value.has_value() ? StringMaker<typename T::value_type>::convert(*value) : "nullopt";
+        } else if constexpr (IsStreamable<T>::value) {
+            std::ostringstream stream;
+            stream << value;
+            return elide_text(stream.str());
+        } else if constexpr (std::is_enum<T>::value) {
+            return std::to_string(static_cast<typename std::underlying_type<T>::type>(value));
+        } else if constexpr (IsRange<T>::value) {
+            return format_elements(std::begin(value), std::end(value));
+        } else if constexpr (IsTupleLike<T>::value) {
+            return std::apply(
+                [](const auto &...elements) {
+                    std::string text = "{";
+                    const char *separator = "";
+                    ((text += separator + StringMaker<typename std::decay<decltype(elements)>::type>::convert(elements), separator = ", "), ...);
+                    return text + "}";
+                },
+                value);
+        } else {
+            return "{?}";
+        }
+    }
+};
+
+// Return std::string based on type, strings and characters are written as they are
+template <typename T>
+inline std::string get_string(const T &var) {
+    if constexpr (std::is_same<T, char>::value) {
+        return std::string(1, var);
+    } else if constexpr (std::is_array<T>::value && std::is_same<typename std::remove_cv<typename std::remove_extent<T>::type>::type, char>::value) {
+        return elide_text(var);
+    } else if constexpr (is_string_like<T>()) {
+        return elide_text(var);
+    } else if constexpr (std::is_same<T, bool>::value) {
+        // Booleans are written as numbers, as std::to_string writes them
+        return std::to_string(var);
+    } else {
+        return StringMaker<T>::convert(var);
+    }
+}
+
+// Return comparison operator of assertion for output
+inline const char *get_comparison_operator(ComparisonType comparison) {
+    switch (comparison) {
+        case ComparisonType::NOT_EQUAL:
+            return " != ";
+        case ComparisonType::LESS:
+            return " < ";
+        case ComparisonType::LESS_EQUAL:
+            return " <= ";
+        case ComparisonType::GREATER:
+            return " > ";
+        case ComparisonType::GREATER_EQUAL:
+            return " >= ";
+        case ComparisonType::MAX_ALLOCATIONS:
+            return " <= ";
+        case ComparisonType::RANGE_EQUAL:
+        case ComparisonType::RANGE_NEAR:
+        case ComparisonType::ULP:
+            // Range assertions describe the comparison in their first operand
+            return "";
+        default:
+            return " == ";
+    }
+}
+
+// Return macro suffix of assertion for output
+inline const char *get_suffix(ComparisonType comparison) {
+    switch (comparison) {
+        case ComparisonType::EQUAL:
+            return "EQUAL";
+        case ComparisonType::TRUE:
+            return "TRUE";
+        case ComparisonType::FALSE:
+            return "FALSE";
+        case ComparisonType::NOT_EQUAL:
+            return "NOT_EQUAL";
+        case ComparisonType::LESS:
+            return "LESS";
+        case ComparisonType::LESS_EQUAL:
+            return "LESS_EQUAL";
+        case ComparisonType::GREATER:
+            return "GREATER";
+        case ComparisonType::GREATER_EQUAL:
+            return "GREATER_EQUAL";
+        case ComparisonType::NO_ALLOCATIONS:
+            return "NO_ALLOCATIONS";
+        case ComparisonType::MAX_ALLOCATIONS:
+            return "MAX_ALLOCATIONS";
+        case ComparisonType::RANGE_EQUAL:
+            return "RANGE_EQUAL";
+        case ComparisonType::RANGE_NEAR:
+            return "RANGE_NEAR";
+        case ComparisonType::ULP:
+            return "ULP";
+    }
+    return "";
+}
+
+#if defined(CORETEST_IMPLEMENTATION)
+// Assertions from other threads
+
+// Assertion recorded on a thread that is not running a test case, with its operands already formatted
+// Nodes are allocated in chunks and reused once merged, their strings keep their capacity
+struct ThreadAssertion {
+    bool passed;
+    AssertionType type;
+    ComparisonType comparison;
+    std::string first;
+    std::string second;
+    bool expression;
+    int thread;
+    ThreadAssertion *next;
+};
+
+// Assertions a thread made while one test case run owned them
+// Only the thread writes the counters and pushes assertions, and only to the segment at the front of its list
+struct ThreadSegment {
+    // Run the assertions are merged into, 0 if no single test case was running
+    uint64_t run = 0;
+    std::atomic<size_t> assertions{0};
+    std::atomic<size_t> assertions_failed{0};
+    // Recorded assertions, most recent first
+    std::atomic<ThreadAssertion *> recorded{nullptr};
+    // Older segments of the same thread
+    ThreadSegment *next = nullptr;
+    // Counter values already merged, only accessed while holding thread_assertions_mutex
+    size_t assertions_merged = 0;
+    size_t assertions_failed_merged = 0;
+};
+
+// Assertions of a thread that is not running a test case, merged into the test case run that owned them
+// Recording an assertion takes no lock, the thread only takes thread_assertions_mutex to start a segment
+// Buffers are never freed, a buffer is reused by a later thread once its owner has exited
+struct alignas(64) ThreadAssertions {
+    // Segments, the current one first, only the owning thread adds segments
+    std::atomic<ThreadSegment *> segments{nullptr};
+    // Nodes free for recording, only accessed by the owning thread
+    ThreadAssertion *free_nodes = nullptr;
+    // Nodes given back by merges, taken whole by the owning thread
+    std::atomic<ThreadAssertion *> merged_nodes{nullptr};
+    std::atomic<bool> in_use{true};
+    ThreadAssertions *next = nullptr;
+};
+
+// Index of the current thread while it runs the body of a TEST_CONCURRENT test case, -1 otherwise
+// Its failed requires end the body, which the stress thread catches
+thread_local int stress_thread_index = -1;
+// Failed assertions of the current thread while it is not running a test case
+thread_local size_t thread_assertions_failed = 0;
+// Run the assertions of the current thread are attributed to, 0 to attribute them to the only running test case
+thread_local uint64_t thread_run = 0;
+
+int get_thread_index() {
+    return std::max(stress_thread_index, 0);
+}
+
+// List of all buffers, buffers are only ever added at the front
+std::atomic<ThreadAssertions *> thread_assertions{nullptr};
+// Held by runner threads while merging and by threads starting a segment
+std::mutex thread_assertions_mutex;
+// Segments unlinked once merged, reused by threads starting a segment
+ThreadSegment *free_segments = nullptr;
+
+// Runs of the test cases currently running, the run id counter and the sole running run are guarded by the mutex
+std::mutex running_mutex;
+std::vector<uint64_t> running_runs;
+uint64_t last_run = 0;
+// Run owning assertions of threads that are not running a test case, 0 unless exactly one test case is running
+std::atomic<uint64_t> owner_run{0};
+
+// Marks the test case of context as running while in scope, giving it a new run id
+// Assertions of other threads are only attributed while it is the only one running
+struct TestRunScope {
+    explicit TestRunScope(TestContext &context) : run(0) {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        run = ++last_run;
+        context.run = run;
+        running_runs.push_back(run);
+        owner_run.store(running_runs.size() == 1 ? run : 0, std::memory_order_release);
+    }
+
+    ~TestRunScope() {
+        std::lock_guard<std::mutex> lock(running_mutex);
+        running_runs.erase(std::find(running_runs.begin(), running_runs.end(), run));
+        owner_run.store(running_runs.size() == 1 ? running_runs[0] : 0, std::memory_order_release);
+    }
+
+    TestRunScope(const TestRunScope &) = delete;
+    TestRunScope &operator=(const TestRunScope &) = delete;
+
+   private:
+    uint64_t run;
+};
+
+// Gives the buffer of a thread back when the thread exits
+struct ThreadAssertionsOwner {
+    ThreadAssertions *buffer = nullptr;
+
+    ~ThreadAssertionsOwner() {
+        if (buffer != nullptr) {
+            buffer->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadAssertionsOwner thread_assertions_owner;
+
+// Return buffer of the current thread, claiming an unused buffer or adding a new one on first use
+ThreadAssertions &get_thread_assertions() {
+    ThreadAssertions *&buffer = thread_assertions_owner.buffer;
+    if (buffer != nullptr) {
+        return *buffer;
+    }
+    for (ThreadAssertions *candidate = thread_assertions.load(std::memory_order_acquire); candidate != nullptr; candidate = candidate->next) {
+        bool in_use = false;
+        if (candidate->in_use.compare_exchange_strong(in_use, true, std::memory_order_acq_rel)) {
+            buffer = candidate;
+            return *buffer;
+        }
+    }
+    buffer = new ThreadAssertions();
+    buffer->next = thread_assertions.load(std::memory_order_relaxed);
+    while (!thread_assertions.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return *buffer;
+}
+
+// Return segment of the current thread for its owning run, starting a segment when the owner has changed
+ThreadSegment &get_thread_segment() {
+    ThreadAssertions &buffer = get_thread_assertions();
+    uint64_t run = thread_run != 0 ? thread_run : owner_run.load(std::memory_order_acquire);
+    ThreadSegment *segment = buffer.segments.load(std::memory_order_relaxed);
+    if (segment != nullptr && segment->run == run) {
+        return *segment;
+    }
+    std::lock_guard<std::mutex> lock(thread_assertions_mutex);
+    ThreadSegment *started = free_segments;
+    if (started != nullptr) {
+        free_segments = started->next;
+    } else {
+        started = new ThreadSegment();
+    }
+    started->run = run;
+    started->assertions.store(0, std::memory_order_relaxed);
+    started->assertions_failed.store(0, std::memory_order_relaxed);
+    started->assertions_merged = 0;
+    started->assertions_failed_merged = 0;
+    started->next = segment;
+    buffer.segments.store(started, std::memory_order_release);
+    return *started;
+}
+
+// Return a free node of buffer, taking back merged nodes or allocating a chunk when none is free
+ThreadAssertion *get_thread_node(ThreadAssertions &buffer) {
+    static const size_t chunk_size = 64;
+    if (buffer.free_nodes == nullptr) {
+        buffer.free_nodes = buffer.merged_nodes.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (buffer.free_nodes == nullptr) {
+        ThreadAssertion *chunk = new ThreadAssertion[chunk_size];
+        for (size_t i = 0; i + 1 < chunk_size; i++) {
+            chunk[i].next = &chunk[i + 1];
+        }
+        chunk[chunk_size - 1].next = nullptr;
+        buffer.free_nodes = chunk;
+    }
+    ThreadAssertion *node = buffer.free_nodes;
+    buffer.free_nodes = node->next;
+    return node;
+}
+
+// Add assertion to the log of context and report it if the test case is running
+void log_assertion(TestContext &context, bool passed, AssertionType type, ComparisonType comparison, const std::string &first, const std::string &second, bool expression, int thread) {
+    if (!context.log.push(passed, type, comparison, first, second, expression, thread)) {
+        context.result.assertions_dropped++;
+        return;
+    }
+    const Assertion &logged = context.log.get_assertions().back();
+    // Bit 2 marks a logged assertion, the thread index is stored offset by one so that -1 fits
+    uint64_t fields = (uint64_t)passed | (uint64_t)expression << 1 | 4 | (uint64_t)type << 8 | (uint64_t)comparison << 16 | (uint64_t)(uint32_t)(thread + 1) << 32;
+    publish_last_logged(context, fields, logged.first, logged.second);
+    if (context.output != nullptr) {
+        reporter->assertion(*context.output, logged);
+        if (!passed) {
+            context.output->out.flush();
+        }
+    }
+}
+
+// Move the assertions of segment not merged yet into result, passing each recorded one to log in order
+// Must be called while holding thread_assertions_mutex, the nodes are given back to buffer
+template <typename Log>
+void merge_segment(ThreadAssertions &buffer, ThreadSegment &segment, TestResult &result, Log log) {
+    size_t assertions = segment.assertions.load(std::memory_order_acquire);
+    size_t assertions_failed = segment.assertions_failed.load(std::memory_order_acquire);
+    result.assertions += assertions - segment.assertions_merged;
+    result.assertions_failed += assertions_failed - segment.assertions_failed_merged;
+    segment.assertions_merged = assertions;
+    segment.assertions_failed_merged = assertions_failed;
+    ThreadAssertion *reversed = nullptr;
+    ThreadAssertion *recorded = segment.recorded.exchange(nullptr, std::memory_order_acquire);
+    if (recorded == nullptr) {
+        return;
+    }
+    ThreadAssertion *last = recorded;
+    while (recorded != nullptr) {
+        ThreadAssertion *next = recorded->next;
+        recorded->next = reversed;
+        reversed = recorded;
+        recorded = next;
+    }
+    for (ThreadAssertion *assertion = reversed; assertion != nullptr; assertion = assertion->next) {
+        log(*assertion);
+    }
+    last->next = buffer.merged_nodes.load(std::memory_order_relaxed);
+    while (!buffer.merged_nodes.compare_exchange_weak(last->next, reversed, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+// Merge segments matching the run of context, threads are expected to be joined before the test case ends
+// Segments other than the current one of a thread are no longer written, so they are freed once merged
+void merge_thread_assertions(TestContext &context) {
+    std::lock_guard<std::mutex> lock(thread_assertions_mutex);
+    for (ThreadAssertions *buffer = thread_assertions.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        ThreadSegment *previous = nullptr;
+        ThreadSegment *segment = buffer->segments.load(std::memory_order_acquire);
+        while (segment != nullptr) {
+            ThreadSegment *next = segment->next;
+            if (segment->run != context.run) {
+                previous = segment;
+            } else {
+                merge_segment(*buffer, *segment, context.result, [&](const ThreadAssertion &assertion) {
+                    log_assertion(context, assertion.passed, assertion.type, assertion.comparison, assertion.first, assertion.second, assertion.expression, assertion.thread);
+                });
+                if (previous == nullptr) {
+                    previous = segment;
+                } else {
+                    previous->next = next;
+                    segment->next = free_segments;
+                    free_segments = segment;
+                }
+            }
+            segment = next;
+        }
+    }
+}
+
+// Move assertions that no test case run merged into result, adding the failed ones to log
+// Called between passes, when no test case is running
+void merge_unattributed_assertions(TestResult &result, AssertionLog &log) {
+    std::lock_guard<std::mutex> lock(thread_assertions_mutex);
+    for (ThreadAssertions *buffer = thread_assertions.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        for (ThreadSegment *segment = buffer->segments.load(std::memory_order_acquire); segment != nullptr; segment = segment->next) {
+            merge_segment(*buffer, *segment, result, [&](const ThreadAssertion &assertion) {
+                if (!assertion.passed && !log.push(assertion.passed, assertion.type, assertion.comparison, assertion.first, assertion.second, assertion.expression, assertion.thread)) {
+                    result.assertions_dropped++;
+                }
+            });
+        }
+    }
+}
+
+void record_assertion(bool passed, AssertionType type, ComparisonType comparison, const std::string &first, const std::string &second, bool expression) {
+    if (current_context == &foreign_context) {
+        ThreadAssertions &buffer = get_thread_assertions();
+        ThreadSegment &segment = get_thread_segment();
+        if (passed == false) {
+            increment_owned(segment.assertions_failed);
+            thread_assertions_failed++;
+        }
+        ThreadAssertion *assertion = get_thread_node(buffer);
+        assertion->passed = passed;
+        assertion->type = type;
+        assertion->comparison = comparison;
+        assertion->first = first;
+        assertion->second = second;
+        assertion->expression = expression;
+        assertion->thread = stress_thread_index;
+        assertion->next = segment.recorded.load(std::memory_order_relaxed);
+        while (!segment.recorded.compare_exchange_weak(assertion->next, assertion, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        if (stress_thread_index < 0) {
+            // A failed require cannot end a test case running on another thread, it is only recorded
+            return;
+        }
+    } else {
+        if (passed == false) {
+            current_context->result.assertions_failed++;
+        }
+        log_assertion(*current_context, passed, type, comparison, first, second, expression, -1);
+    }
+#if !defined(CORETEST_NO_EXCEPTIONS)
+    if (passed == false) {
+        switch (type) {
+            case AssertionType::REQUIRE:
+                throw CoreTestError("Failed require encountered");
+                break;
+            default:
+                break;
+        }
+    }
+#endif
+}
+#endif
+
+// Expression decomposition
+
+// Format operand of an assertion, operands are passed type erased so that recording them is not instantiated per call site
+typedef std::string (*OperandFormatter)(const void *operand);
+
+template <typename T>
+std::string format_operand(const void *operand) {
+    return get_string(*static_cast<const T *>(operand));
+}
+
+// Outcome of an assertion with its operands, which are only formatted if the assertion is recorded
+struct ExpressionResult {
+    bool passed;
+    ComparisonType comparison;
+    const void *first;
+    OperandFormatter format_first;
+    // Null for assertions on a single value
+    const void *second;
+    OperandFormatter format_second;
+};
+
+// Count assertion of the current test case, returns if it has to be recorded
+bool count_assertion(bool passed);
+// Format operands and record assertion, kept out of line so that each assertion expands to a small call
+CORETEST_NOINLINE CORETEST_COLD void record_operands(AssertionType type, bool expression, const ExpressionResult &result);
+// Count and record an assertion that failed, passed with --success or ran on a thread outside the runner
+CORETEST_NOINLINE CORETEST_COLD bool handle_assertion(AssertionType type, bool expression, const ExpressionResult &result);
+
+// Count a passed assertion of a test case inline, which is a compare and a counter increment
+// Returns false if the assertion takes the out of line path through handle_assertion instead
+inline bool count_passed(bool passed) {
+    TestContext *context = current_context;
+    if (passed && context->count_passed_inline) {
+        increment_owned(context->assertions_run);
+        return true;
+    }
+    return false;
+}
+
+#if defined(CORETEST_IMPLEMENTATION)
+bool count_assertion(bool passed) {
+    if (current_context == &foreign_context) {
+        increment_owned(get_thread_segment().assertions);
+    } else {
+        increment_owned(current_context->assertions_run);
+    }
+    return !passed || show_successful;
+}
+
+bool handle_assertion(AssertionType type, bool expression, const ExpressionResult &result) {
+    if (count_assertion(result.passed)) {
+        record_operands(type, expression, result);
+    }
+    return result.passed;
+}
+
+void record_operands(AssertionType type, bool expression, const ExpressionResult &result) {
+    AllocationPause pause;
+    std::string second;
+    if (result.format_second != nullptr) {
+        second = result.format_second(result.second);
+    } else if (!expression) {
+        second = (result.comparison == ComparisonType::FALSE) ? "false" : "true";
+    }
+    record_assertion(result.passed, type, result.comparison, result.format_first(result.first), second, expression);
+}
+#endif
+
+// Arrays are compared and printed as pointers, as operands were once copied into auto variables
+template <typename T>
+inline const T &decay_operand(const T &operand) {
+    return operand;
+}
+
+template <typename Element, size_t size>
+inline const Element *decay_operand(const Element (&operand)[size]) {
+    return operand;
+}
+
+// Out of line path of assert_comparison, instantiated once per comparison and operand types so that call sites stay small
+template <ComparisonType comparison, typename First, typename Second>
+CORETEST_NOINLINE CORETEST_COLD bool handle_comparison(AssertionType type, bool expression, bool passed, const First &first, const Second &second) {
+    if (count_assertion(passed)) {
+        record_operands(type, expression, ExpressionResult{passed, comparison, &first, format_operand<First>, &second, format_operand<Second>});
+    }
+    return passed;
+}
+
+// Compare operands and record the assertion if needed, returns if it has passed
+// Only the compare and the count of a passed assertion are inlined, which keeps a passing check cheap
+template <ComparisonType comparison, typename First, typename Second>
+inline bool assert_comparison(AssertionType type, bool expression, const First &first_operand, const Second &second_operand) {
+    const auto &first = decay_operand(first_operand);
+    const auto &second = decay_operand(second_operand);
+    bool passed;
+    if constexpr (comparison == ComparisonType::EQUAL) {
+        passed = static_cast<bool>(first == second);
+    } else if constexpr (comparison == ComparisonType::NOT_EQUAL) {
+        passed = static_cast<bool>(first != second);
+    } else if constexpr (comparison == ComparisonType::LESS) {
+        passed = static_cast<bool>(first < second);
+    } else if constexpr (comparison == ComparisonType::LESS_EQUAL) {
+        passed = static_cast<bool>(first <= second);
+    } else if constexpr (comparison == ComparisonType::GREATER) {
+        passed = static_cast<bool>(first > second);
+    } else {
+        passed = static_cast<bool>(first >= second);
+    }
+    if (count_passed(passed)) {
+        return true;
+    }
+    using FirstDecayed = typename std::decay<decltype(first)>::type;
+    using SecondDecayed = typename std::decay<decltype(second)>::type;
+    return handle_comparison<comparison, FirstDecayed, SecondDecayed>(type, expression, passed, first, second);
+}
+
+// Assert that a value converts to true, as REQUIRE(value) does
+template <typename First>
+inline bool assert_value(AssertionType type, const First &first) {
+    bool passed = static_cast<bool>(first);
+    if (count_passed(passed)) {
+        return true;
+    }
+    return handle_assertion(type, true, ExpressionResult{passed, ComparisonType::TRUE, &first, format_operand<First>, nullptr, nullptr});
+}
+
+// Assert that value is true or false, as REQUIRE_TRUE and REQUIRE_FALSE compare it with true or false
+template <typename First>
+inline bool assert_boolean(AssertionType type, ComparisonType comparison, const First &first) {
+    bool passed = (comparison == ComparisonType::TRUE) ? static_cast<bool>(first == true) : static_cast<bool>(first == false);
+    if (count_passed(passed)) {
+        return true;
+    }
+    return handle_assertion(type, false, ExpressionResult{passed, comparison, &first, format_operand<First>, nullptr, nullptr});
+}
+
+// Returned by comparisons of a decomposed expression, which have already been asserted
+struct AssertionHandled {
+    bool passed;
+};
+
+// Left operand of a decomposed expression, captured by reference until the comparison operator is applied
+// The assertion type is a template argument, as objects without state keep call sites cheap to compile
+template <AssertionType type, typename First>
+class ExpressionLhs {
+   public:
+    explicit ExpressionLhs(const First &new_first) : first(new_first) {}
+
+    template <typename Second>
+    AssertionHandled operator==(const Second &second) const {
+        return {assert_comparison<ComparisonType::EQUAL>(type, true, first, second)};
+    }
+
+    template <typename Second>
+    AssertionHandled operator!=(const Second &second) const {
+        return {assert_comparison<ComparisonType::NOT_EQUAL>(type, true, first, second)};
+    }
+
+    template <typename Second>
+    AssertionHandled operator<(const Second &second) const {
+        return {assert_comparison<ComparisonType::LESS>(type, true, first, second)};
+    }
+
+    template <typename Second>
+    AssertionHandled operator<=(const Second &second) const {
+        return {assert_comparison<ComparisonType::LESS_EQUAL>(type, true, first, second)};
+    }
+
+    template <typename Second>
+    AssertionHandled operator>(const Second &second) const {
+        return {assert_comparison<ComparisonType::GREATER>(type, true, first, second)};
+    }
+
+    template <typename Second>
+    AssertionHandled operator>=(const Second &second) const {
+        return {assert_comparison<ComparisonType::GREATER_EQUAL>(type, true, first, second)};
+    }
+
+    // Expression without a comparison, such as REQUIRE(pointer)
+    bool assert_value() const {
+        return coretest::assert_value(type, first);
+    }
+
+   private:
+    const First &first;
+};
+
+// Captures the left operand of an expression, binds tighter than the comparison operators that follow it
+template <AssertionType type>
+struct Decomposer {
+    template <typename First>
+    ExpressionLhs<type, First> operator<=(const First &first) const {
+        return ExpressionLhs<type, First>(first);
+    }
+};
+
+inline bool assert_expression(AssertionHandled handled) {
+    return handled.passed;
+}
+
+template <AssertionType type, typename First>
+inline bool assert_expression(const ExpressionLhs<type, First> &lhs) {
+    return lhs.assert_value();
+}
+
+template <typename First, typename Second>
+inline void add_assertion(bool passed, AssertionType type, ComparisonType comparison, const First &first, const Second &second) {
+    if (count_assertion(passed)) {
+        record_operands(type, false, ExpressionResult{passed, comparison, &first, format_operand<First>, &second, format_operand<Second>});
+    }
+}
+
+// Return hardware performance counter values of the current test case so far
+inline PerfCounts read_perf_counters() {
+    return current_context->perf.read();
+}
+
+// Return if hardware performance counters are counting for the current test case
+inline bool perf_counters_available() {
+    return current_context->perf.is_running();
+}
+
+// Checks number of allocations made in the scope of REQUIRE_NO_ALLOCATIONS and CHECK_MAX_ALLOCATIONS
+class AllocationScope {
+   public:
+    AllocationScope(AssertionType new_type, size_t new_max_allocations) : type(new_type), max_allocations(new_max_allocations) {}
+
+    // Returns true once to run the scope body, then asserts on the allocations made by the body
+    bool next() {
+        if (!started) {
+            started = true;
+            start_allocations = current_context->result.allocations.allocations;
+            return true;
+        }
+        size_t allocations = current_context->result.allocations.allocations - start_allocations;
+        if (max_allocations == 0) {
+            add_assertion(allocations == 0, type, ComparisonType::NO_ALLOCATIONS, allocations, 0);
+        } else {
+            add_assertion(allocations <= max_allocations, type, ComparisonType::MAX_ALLOCATIONS, allocations, max_allocations);
+        }
+        return false;
+    }
+
+   private:
+    AssertionType type;
+    size_t max_allocations;
+    size_t start_allocations = 0;
+    bool started = false;
+};
+
+// Range comparisons
+
+// Tolerances of REQUIRE_RANGE_NEAR, CHECK_RANGE_NEAR, REQUIRE_ULP and CHECK_ULP
+struct RangeTolerance {
+    double absolute = 0;
+    double relative = 0;
+    uint64_t ulps = 0;
+};
+
+// Number of mismatching elements printed by a failed range comparison
+const size_t range_mismatches_shown = 3;
+
+// Mismatches found by a range comparison
+struct RangeMismatches {
+    size_t count = 0;
+    size_t indices[range_mismatches_shown];
+    // Largest error among mismatches, NaN if errors can not be computed for the element type
+    double max_error = 0;
+    size_t max_error_index = 0;
+
+    inline void add(size_t index, double error) {
+        if (count < range_mismatches_shown) {
+            indices[count] = index;
+        }
+        // NaN errors, such as those of NaN elements, are only reported if no error is finite
+        if (count == 0 || error > max_error || (std::isnan(max_error) && !std::isnan(error))) {
+            max_error = error;
+            max_error_index = index;
+        }
+        count++;
+    }
+};
+
+// Return distance between two floating point values in units in the last place, UINT64_MAX if one is NaN
+template <typename T>
+uint64_t get_ulp_distance(T first, T second) {
+    static_assert(std::is_floating_point<T>::value, "ULP distance requires floating point values");
+    using Bits = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+    if (first == second) {
+        return 0;
+    }
+    if (std::isnan(first) || std::isnan(second)) {
+        return UINT64_MAX;
+    }
+    Bits first_bits;
+    Bits second_bits;
+    std::memcpy(&first_bits, &first, sizeof(T));
+    std::memcpy(&second_bits, &second, sizeof(T));
+    const Bits sign = (Bits)1 << (sizeof(T) * 8 - 1);
+    uint64_t first_magnitude = first_bits & ~sign;
+    uint64_t second_magnitude = second_bits & ~sign;
+    if ((first_bits & sign) != (second_bits & sign)) {
+        // Values on both sides of zero are apart by the sum of their distances from zero
+        return first_magnitude + second_magnitude;
+    }
+    return first_magnitude > second_magnitude ? first_magnitude - second_magnitude : second_magnitude - first_magnitude;
+}
+
+// Return if two elements match, floating point arithmetic is done in the element type so that it agrees with the SIMD kernels
+template <typename First, typename Second>
+inline bool elements_match(const First &first, const Second &second, ComparisonType comparison, const RangeTolerance &tolerance) {
+    if (comparison == ComparisonType::RANGE_EQUAL) {
+        return first == second;
+    }
+    if constexpr (std::is_arithmetic<First>::value && std::is_arithmetic<Second>::value) {
+        using Common = typename std::conditional<std::is_same<First, Second>::value && std::is_floating_point<First>::value, First, double>::type;
+        Common a = (Common)first;
+        Common b = (Common)second;
+        if (comparison == ComparisonType::RANGE_NEAR) {
+            Common limit = std::max((Common)tolerance.absolute, (Common)tolerance.relative * std::max(std::fabs(a), std::fabs(b)));
+            return a == b || std::fabs(a - b) <= limit;
+        }
+        if constexpr (std::is_floating_point<Common>::value) {
+            return get_ulp_distance(a, b) <= tolerance.ulps;
+        }
+    }
+    return false;
+}
+
+// Return error between two mismatching elements, ULP distance for ULP comparisons
+template <typename First, typename Second>
+double get_element_error(const First &first, const Second &second, ComparisonType comparison) {
+    if constexpr (std::is_arithmetic<First>::value && std::is_arithmetic<Second>::value) {
+        if (comparison == ComparisonType::ULP) {
+            using Common = typename std::conditional<std::is_same<First, Second>::value && std::is_floating_point<First>::value, First, double>::type;
+            uint64_t distance = get_ulp_distance((Common)first, (Common)second);
+            return distance == UINT64_MAX ? NAN : (double)distance;
+        }
+        return std::fabs((double)first - (double)second);
+    }
+    return NAN;
+}
+
+// Scans from index while whole vectors of elements match, returns index of the first vector that may hold a mismatch
+// Elements of that vector are checked by elements_match, which is also used for the tail of the range
+typedef size_t (*RangeKernel)(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance);
+
+// Kernel and number of elements it compares at once
+struct RangeKernelInfo {
+    RangeKernel kernel = nullptr;
+    size_t width = 1;
+};
+
+#if defined(CORETEST_HAS_X86_SIMD)
+inline bool has_avx2() {
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return supported;
+}
+
+// Integers are equal if their bytes are equal, element_size is given as the kernel width
+template <size_t element_size>
+size_t equal_bytes_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const char *a = static_cast<const char *>(first);
+    const char *b = static_cast<const char *>(second);
+    const size_t step = 16 / element_size;
+    for (; index + step <= size; index += step) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + index * element_size));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + index * element_size));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) {
+            break;
+        }
+    }
+    return index;
+}
+
+template <size_t element_size>
+__attribute__((target("avx2"))) size_t equal_bytes_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const char *a = static_cast<const char *>(first);
+    const char *b = static_cast<const char *>(second);
+    const size_t step = 32 / element_size;
+    for (; index + step <= size; index += step) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + index * element_size));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + index * element_size));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != -1) {
+            break;
+        }
+    }
+    return index;
+}
+
+inline size_t equal_float_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    for (; index + 4 <= size; index += 4) {
+        if (_mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(a + index), _mm_loadu_ps(b + index))) != 0xf) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t equal_float_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    for (; index + 8 <= size; index += 8) {
+        if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(a + index), _mm256_loadu_ps(b + index), _CMP_EQ_OQ)) != 0xff) {
+            break;
+        }
+    }
+    return index;
+}
+
+inline size_t equal_double_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const double *a = static_cast<const double *>(first);
+    const double *b = static_cast<const double *>(second);
+    for (; index + 2 <= size; index += 2) {
+        if (_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(a + index), _mm_loadu_pd(b + index))) != 0x3) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t equal_double_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &) {
+    const double *a = static_cast<const double *>(first);
+    const double *b = static_cast<const double *>(second);
+    for (; index + 4 <= size; index += 4) {
+        if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index), _CMP_EQ_OQ)) != 0xf) {
+            break;
+        }
+    }
+    return index;
+}
+
+// Elements are near if they are equal or |a - b| <= max(absolute, relative * max(|a|, |b|))
+inline size_t near_float_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 absolute = _mm_set1_ps((float)tolerance.absolute);
+    const __m128 relative = _mm_set1_ps((float)tolerance.relative);
+    for (; index + 4 <= size; index += 4) {
+        __m128 x = _mm_loadu_ps(a + index);
+        __m128 y = _mm_loadu_ps(b + index);
+        __m128 difference = _mm_andnot_ps(sign, _mm_sub_ps(x, y));
+        __m128 magnitude = _mm_max_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y));
+        __m128 limit = _mm_max_ps(absolute, _mm_mul_ps(relative, magnitude));
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmpeq_ps(x, y), _mm_cmple_ps(difference, limit))) != 0xf) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t near_float_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 absolute = _mm256_set1_ps((float)tolerance.absolute);
+    const __m256 relative = _mm256_set1_ps((float)tolerance.relative);
+    for (; index + 8 <= size; index += 8) {
+        __m256 x = _mm256_loadu_ps(a + index);
+        __m256 y = _mm256_loadu_ps(b + index);
+        __m256 difference = _mm256_andnot_ps(sign, _mm256_sub_ps(x, y));
+        __m256 magnitude = _mm256_max_ps(_mm256_andnot_ps(sign, x), _mm256_andnot_ps(sign, y));
+        __m256 limit = _mm256_max_ps(absolute, _mm256_mul_ps(relative, magnitude));
+        __m256 near = _mm256_or_ps(_mm256_cmp_ps(x, y, _CMP_EQ_OQ), _mm256_cmp_ps(difference, limit, _CMP_LE_OQ));
+        if (_mm256_movemask_ps(near) != 0xff) {
+            break;
+        }
+    }
+    return index;
+}
+
+inline size_t near_double_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const double *a = static_cast<const double *>(first);
+    const double *b = static_cast<const double *>(second);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d absolute = _mm_set1_pd(tolerance.absolute);
+    const __m128d relative = _mm_set1_pd(tolerance.relative);
+    for (; index + 2 <= size; index += 2) {
+        __m128d x = _mm_loadu_pd(a + index);
+        __m128d y = _mm_loadu_pd(b + index);
+        __m128d difference = _mm_andnot_pd(sign, _mm_sub_pd(x, y));
+        __m128d magnitude = _mm_max_pd(_mm_andnot_pd(sign, x), _mm_andnot_pd(sign, y));
+        __m128d limit = _mm_max_pd(absolute, _mm_mul_pd(relative, magnitude));
+        if (_mm_movemask_pd(_mm_or_pd(_mm_cmpeq_pd(x, y), _mm_cmple_pd(difference, limit))) != 0x3) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t near_double_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const double *a = static_cast<const double *>(first);
+    const double *b = static_cast<const double *>(second);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d absolute = _mm256_set1_pd(tolerance.absolute);
+    const __m256d relative = _mm256_set1_pd(tolerance.relative);
+    for (; index + 4 <= size; index += 4) {
+        __m256d x = _mm256_loadu_pd(a + index);
+        __m256d y = _mm256_loadu_pd(b + index);
+        __m256d difference = _mm256_andnot_pd(sign, _mm256_sub_pd(x, y));
+        __m256d magnitude = _mm256_max_pd(_mm256_andnot_pd(sign, x), _mm256_andnot_pd(sign, y));
+        __m256d limit = _mm256_max_pd(absolute, _mm256_mul_pd(relative, magnitude));
+        __m256d near = _mm256_or_pd(_mm256_cmp_pd(x, y, _CMP_EQ_OQ), _mm256_cmp_pd(difference, limit, _CMP_LE_OQ));
+        if (_mm256_movemask_pd(near) != 0xf) {
+            break;
+        }
+    }
+    return index;
+}
+
+// Elements are within the ULP tolerance if they are equal, or neither is NaN, they have the same sign and their magnitudes are close
+// Elements on both sides of zero are left to elements_match
+inline size_t ulp_float_sse2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    const __m128i magnitude_mask = _mm_set1_epi32(0x7fffffff);
+    const __m128i ulps = _mm_set1_epi32((int)std::min<uint64_t>(tolerance.ulps, 0x7fffffff));
+    for (; index + 4 <= size; index += 4) {
+        __m128 x = _mm_loadu_ps(a + index);
+        __m128 y = _mm_loadu_ps(b + index);
+        __m128i x_bits = _mm_castps_si128(x);
+        __m128i y_bits = _mm_castps_si128(y);
+        __m128i same_sign = _mm_cmpeq_epi32(_mm_srai_epi32(x_bits, 31), _mm_srai_epi32(y_bits, 31));
+        __m128i distance = _mm_sub_epi32(_mm_and_si128(x_bits, magnitude_mask), _mm_and_si128(y_bits, magnitude_mask));
+        __m128i too_far = _mm_or_si128(_mm_cmpgt_epi32(distance, ulps), _mm_cmpgt_epi32(_mm_sub_epi32(_mm_setzero_si128(), distance), ulps));
+        __m128i close = _mm_andnot_si128(too_far, _mm_and_si128(same_sign, _mm_castps_si128(_mm_cmpord_ps(x, y))));
+        if (_mm_movemask_epi8(_mm_or_si128(close, _mm_castps_si128(_mm_cmpeq_ps(x, y)))) != 0xffff) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t ulp_float_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const float *a = static_cast<const float *>(first);
+    const float *b = static_cast<const float *>(second);
+    const __m256i magnitude_mask = _mm256_set1_epi32(0x7fffffff);
+    const __m256i ulps = _mm256_set1_epi32((int)std::min<uint64_t>(tolerance.ulps, 0x7fffffff));
+    for (; index + 8 <= size; index += 8) {
+        __m256 x = _mm256_loadu_ps(a + index);
+        __m256 y = _mm256_loadu_ps(b + index);
+        __m256i x_bits = _mm256_castps_si256(x);
+        __m256i y_bits = _mm256_castps_si256(y);
+        __m256i same_sign = _mm256_cmpeq_epi32(_mm256_srai_epi32(x_bits, 31), _mm256_srai_epi32(y_bits, 31));
+        __m256i distance = _mm256_abs_epi32(_mm256_sub_epi32(_mm256_and_si256(x_bits, magnitude_mask), _mm256_and_si256(y_bits, magnitude_mask)));
+        __m256i close = _mm256_andnot_si256(_mm256_cmpgt_epi32(distance, ulps), _mm256_and_si256(same_sign, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_ORD_Q))));
+        if (_mm256_movemask_epi8(_mm256_or_si256(close, _mm256_castps_si256(_mm256_cmp_ps(x, y, _CMP_EQ_OQ)))) != -1) {
+            break;
+        }
+    }
+    return index;
+}
+
+__attribute__((target("avx2"))) inline size_t ulp_double_avx2(const void *first, const void *second, size_t index, size_t size, const RangeTolerance &tolerance) {
+    const double *a = static_cast<const double *>(first);
+    const double *b = static_cast<const double *>(second);
+    const __m256i magnitude_mask = _mm256_set1_epi64x(0x7fffffffffffffffll);
+    const __m256i ulps = _mm256_set1_epi64x((long long)std::min<uint64_t>(tolerance.ulps, 0x7fffffffffffffffull));
+    const __m256i zero = _mm256_setzero_si256();
+    for (; index + 4 <= size; index += 4) {
+        __m256d x = _mm256_loadu_pd(a + index);
+        __m256d y = _mm256_loadu_pd(b + index);
+        __m256i x_bits = _mm256_castpd_si256(x);
+        __m256i y_bits = _mm256_castpd_si256(y);
+        __m256i same_sign = _mm256_cmpeq_epi64(_mm256_cmpgt_epi64(zero, x_bits), _mm256_cmpgt_epi64(zero, y_bits));
+        __m256i distance = _mm256_sub_epi64(_mm256_and_si256(x_bits, magnitude_mask), _mm256_and_si256(y_bits, magnitude_mask));
+        __m256i too_far = _mm256_or_si256(_mm256_cmpgt_epi64(distance, ulps), _mm256_cmpgt_epi64(_mm256_sub_epi64(zero, distance), ulps));
+        __m256i close = _mm256_andnot_si256(too_far, _mm256_and_si256(same_sign, _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_ORD_Q))));
+        if (_mm256_movemask_epi8(_mm256_or_si256(close, _mm256_castpd_si256(_mm256_cmp_pd(x, y, _CMP_EQ_OQ)))) != -1) {
+            break;
+        }
+    }
+    return index;
+}
+#endif
+
+// Return SIMD kernel for comparing ranges of First and Second, the kernel is nullptr if elements are only compared one by one
+template <typename First, typename Second>
+RangeKernelInfo get_range_kernel(ComparisonType comparison) {
+    RangeKernelInfo info;
+#if defined(CORETEST_HAS_X86_SIMD)
+    if constexpr (std::is_same<First, Second>::value) {
+        bool avx2 = has_avx2();
+        if constexpr (std::is_integral<First>::value) {
+            if (comparison == ComparisonType::RANGE_EQUAL) {
+                info.kernel = avx2 ? equal_bytes_avx2<sizeof(First)> : equal_bytes_sse2<sizeof(First)>;
+                info.width = (avx2 ? 32 : 16) / sizeof(First);
+            }
+        } else if constexpr (std::is_same<First, float>::value) {
+            const RangeKernel sse2[] = {equal_float_sse2, near_float_sse2, ulp_float_sse2};
+            const RangeKernel avx2_kernels[] = {equal_float_avx2, near_float_avx2, ulp_float_avx2};
+            size_t kind = comparison == ComparisonType::RANGE_EQUAL ? 0 : (comparison == ComparisonType::RANGE_NEAR ? 1 : 2);
+            info.kernel = avx2 ? avx2_kernels[kind] : sse2[kind];
+            info.width = avx2 ? 8 : 4;
+        } else if constexpr (std::is_same<First, double>::value) {
+            if (comparison == ComparisonType::ULP) {
+                // 64-bit integer comparisons need AVX2
+                info.kernel = avx2 ? ulp_double_avx2 : nullptr;
+                info.width = avx2 ? 4 : 1;
+            } else {
+                bool equal = comparison == ComparisonType::RANGE_EQUAL;
+                info.kernel = avx2 ? (equal ? equal_double_avx2 : near_double_avx2) : (equal ? equal_double_sse2 : near_double_sse2);
+                info.width = avx2 ? 4 : 2;
+            }
+        }
+    }
+#else
+    (void)comparison;
+#endif
+    return info;
+}
+
+// Compare size elements of first and second
+template <typename First, typename Second>
+RangeMismatches compare_elements(const First *first, const Second *second, size_t size, ComparisonType comparison, const RangeTolerance &tolerance) {
+    RangeMismatches mismatches;
+    RangeKernelInfo info = get_range_kernel<First, Second>(comparison);
+    size_t index = 0;
+    while (index < size) {
+        if (info.kernel != nullptr) {
+            index = info.kernel(first, second, index, size, tolerance);
+        }
+        size_t end = std::min(size, index + info.width);
+        for (; index < end; index++) {
+            if (!elements_match(first[index], second[index], comparison, tolerance)) {
+                mismatches.add(index, get_element_error(first[index], second[index], comparison));
+            }
+        }
+    }
+    return mismatches;
+}
+
+// Contiguous elements compared by a range assertion, a scalar is a range of one element
+template <typename T>
+struct RangeView {
+    const T *data;
+    size_t size;
+    bool scalar;
+};
+
+template <typename T>
+auto view_range(const T &value) {
+    if constexpr (std::is_arithmetic<T>::value) {
+        return RangeView<T>{&value, 1, true};
+    } else {
+        using Element = typename std::remove_cv<typename std::remove_reference<decltype(*std::data(value))>::type>::type;
+        return RangeView<Element>{std::data(value), (size_t)std::size(value), false};
+    }
+}
+
+// Return element formatted with enough digits to tell floating point values apart
+template <typename T>
+std::string format_element(const T &value) {
+    if constexpr (std::is_floating_point<T>::value) {
+        char text[48];
+        snprintf(text, sizeof(text), "%.*g", std::numeric_limits<T>::max_digits10, (double)value);
+        return text;
+    } else {
+        return get_string(value);
+    }
+}
+
+// Return error formatted for a failed range assertion
+inline std::string format_error(double error, ComparisonType comparison) {
+    if (std::isnan(error)) {
+        return comparison == ComparisonType::ULP ? "NaN" : "";
+    }
+    char text[48];
+    snprintf(text, sizeof(text), comparison == ComparisonType::ULP ? "%.0f ulps" : "%g", error);
+    return text;
+}
+
+// Assert on elements of two ranges or scalars, recording one assertion for the whole range, returns if it has passed
+template <typename First, typename Second>
+bool add_range_assertion(AssertionType type, ComparisonType comparison, const First &first, const Second &second, const RangeTolerance &tolerance) {
+    auto first_range = view_range(first);
+    auto second_range = view_range(second);
+    if (first_range.size != second_range.size) {
+        count_assertion(false);
+        AllocationPause pause;
+        record_assertion(false, type, comparison, "sizes differ: " + std::to_string(first_range.size) + " vs " + std::to_string(second_range.size), "");
+        return false;
+    }
+    RangeMismatches mismatches = compare_elements(first_range.data, second_range.data, first_range.size, comparison, tolerance);
+    if (!count_assertion(mismatches.count == 0)) {
+        return mismatches.count == 0;
+    }
+    AllocationPause pause;
+    std::string description;
+    if (first_range.scalar && second_range.scalar) {
+        description = format_element(first_range.data[0]) + " vs " + format_element(second_range.data[0]);
+        std::string error = format_error(mismatches.max_error, comparison);
+        if (mismatches.count > 0 && !error.empty()) {
+            description += ", error " + error;
+        }
+    } else if (mismatches.count == 0) {
+        description = std::to_string(first_range.size) + " elements match";
+    } else {
+        description = std::to_string(mismatches.count) + " of " + std::to_string(first_range.size) + " elements differ:";
+        for (size_t i = 0; i < std::min(mismatches.count, range_mismatches_shown); i++) {
+            size_t index = mismatches.indices[i];
+            description += " [" + std::to_string(index) + "] " + format_element(first_range.data[index]) + " vs " + format_element(second_range.data[index]) + ",";
+        }
+        if (mismatches.count > range_mismatches_shown) {
+            description += " ...,";
+        }
+        std::string error = format_error(mismatches.max_error, comparison);
+        if (!error.empty()) {
+            description += " max error " + error + " at [" + std::to_string(mismatches.max_error_index) + "]";
+        } else {
+            description.pop_back();
+        }
+    }
+    record_assertion(mismatches.count == 0, type, comparison, description, "");
+    return mismatches.count == 0;
+}
+
+#if defined(CORETEST_IMPLEMENTATION)
+// Output functions
+
+void print_help(OutputBuffer &out) {
+    out << '\n';
+    out << "usage:" << '\n';
+    out.repeat(' ', 4) << "<executable> [<test name> ... ] options"
+                       << "\n\n";
+    out << "options:" << '\n';
+    // Compose args string of each option
+    std::vector<std::pair<std::string, const Option *>> args;
+    args.reserve(options_unordered_map.size());
+    size_t max_argument_length = 0;
+    for (const auto &element : options_unordered_map) {
+        const Option &option = element.second;
+        std::string option_args;
+        const std::vector<std::string> &option_args_vector = option.get_args();
+        for (size_t i = 0; i < option_args_vector.size(); i++) {
+            option_args += option_args_vector[i];
+            if (i != option_args_vector.size() - 1) {
+                // Not last arg iteration
+                option_args += ", ";
+            }
+        }
+        max_argument_length = std::max(option_args.size(), max_argument_length);
+        args.emplace_back(std::move(option_args), &option);
+    }
+    // Print options
+    for (const auto &arg : args) {
+        out.repeat(' ', 4) << arg.first;
+        out.repeat(' ', (max_argument_length - arg.first.length()) + 5) << arg.second->get_description() << '\n';
+    }
+    out << "\nSee documentation for more information" << '\n';
+}
+
+// Print formatted test name with file name and line number
+void print_test(const Test &test, OutputBuffer &out) {
+    out.repeat('-', separator_length) << '\n';
+    out << test.test_name << " ( " << test.file_name << ":" << test.line_number << " )" << '\n';
+}
+
+// Pass each piece of an assertion in the form it is written, such as CHECK_EQUAL( 1 == 2 ), to write
+// Assertions of TEST_CONCURRENT threads are followed by the index of their thread
+template <typename Write>
+void write_assertion(const Assertion &assertion, Write write) {
+    write(assertion.type == AssertionType::REQUIRE ? "REQUIRE" : "CHECK");
+    if (assertion.expression) {
+        write("( ");
+        write(assertion.first);
+        if (assertion.comparison != ComparisonType::TRUE) {
+            write(get_comparison_operator(assertion.comparison));
+            write(assertion.second);
+        }
+    } else {
+        write("_");
+        write(get_suffix(assertion.comparison));
+        write("( ");
+        write(assertion.first);
+        write(get_comparison_operator(assertion.comparison));
+        write(assertion.second);
+    }
+    write(" )");
+    if (assertion.thread >= 0) {
+        write(" on thread ");
+        write(std::to_string(assertion.thread));
+    }
+}
+
+// Print assertion
+void print_assertion(const Assertion &assertion, OutputBuffer &out) {
+    if (assertion.passed) {
+        out << "PASSED:" << '\n';
+    } else {
+        out << "FAILED:" << '\n';
+    }
+    out.repeat(' ', 4);
+    write_assertion(assertion, [&](std::string_view text) { out << text; });
+    out << '\n';
+}
+
+// Return number of decimal digits of value
+inline size_t count_digits(size_t value) {
+    size_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Write duration in nanoseconds formatted with a unit to text, which must hold 48 characters, and return its length
+size_t format_duration(int64_t nanoseconds, char *text) {
+    size_t length;
+    const char *unit;
+    if (nanoseconds < 1000) {
+        length = OutputBuffer::format_integer(nanoseconds, text);
+        unit = " ns";
+    } else if (nanoseconds < 1000000) {
+        length = OutputBuffer::format_fixed(nanoseconds * 1e-3, 3, text);
+        unit = " us";
+    } else if (nanoseconds < 1000000000) {
+        length = OutputBuffer::format_fixed(nanoseconds * 1e-6, 3, text);
+        unit = " ms";
+    } else {
+        length = OutputBuffer::format_fixed(nanoseconds * 1e-9, 3, text);
+        unit = " s";
+    }
+    size_t unit_length = std::strlen(unit);
+    std::memcpy(text + length, unit, unit_length);
+    return length + unit_length;
+}
+
+// Print end results
+void print_results(const RunTotals &totals, OutputBuffer &out) {
+    out << '\n';
+    out.repeat('=', separator_length) << '\n';
+    if (totals.tests_failed > 0 || totals.assertions_failed_unattributed > 0) {
+        // Get maximum string size for counts for output alignment
+        size_t tests_count_size = count_digits(totals.tests);
+        size_t assertions_count_size = count_digits(totals.assertions);
+        size_t max_size = std::max(tests_count_size, assertions_count_size);
+        out << "test cases: " << totals.tests;
+        out.repeat(' ', max_size - tests_count_size) << " | " << totals.tests_failed << " failed" << '\n';
+        out << "assertions: " << totals.assertions;
+        out.repeat(' ', max_size - assertions_count_size) << " | " << totals.assertions_failed << " failed" << '\n';
+    } else {
         // All tests have passed
-        std::cout << std::string(separator_length, '=') << '\n';
-        std::cout << "All tests passed ( " << assertions.size() << " assertions in " << tests.size() << " test cases )" << '\n';
+        out << "All tests passed ( " << totals.assertions << " assertions in " << totals.tests << " test cases )" << '\n';
+    }
+    if (totals.tests_not_run > 0) {
+        out << "stopped after " << max_failures << (max_failures == 1 ? " failure" : " failures") << ", " << totals.tests_not_run << (totals.tests_not_run == 1 ? " test case" : " test cases") << " not run" << '\n';
+    }
+}
+
+// Print benchmark statistics
+void print_benchmark(const BenchmarkStatistics &statistics, OutputBuffer &out) {
+    out << "BENCHMARK:" << '\n';
+    out.repeat(' ', 4) << statistics.samples << " samples of " << statistics.iterations << " iterations" << '\n';
+    out.repeat(' ', 4) << "mean:   " << FixedPoint{statistics.mean, 3} << " ns" << '\n';
+    out.repeat(' ', 4) << "median: " << FixedPoint{statistics.median, 3} << " ns" << '\n';
+    out.repeat(' ', 4) << "stddev: " << FixedPoint{statistics.stddev, 3} << " ns" << '\n';
+    out.repeat(' ', 4) << "min:    " << FixedPoint{statistics.min, 3} << " ns" << '\n';
+    out.repeat(' ', 4) << FixedPoint{statistics.median > 0 ? 1e9 / statistics.median : 0, 0} << " iterations per second" << '\n';
+    if (statistics.perf.available != 0) {
+        const PerfCounts &perf = statistics.perf;
+        double iterations = (double)statistics.iterations * statistics.samples;
+        const char *names[PerfCounts::counter_count] = {"cycles", "instructions", "branch misses", "L1D misses", "LLC misses"};
+        for (int counter = 0; counter < PerfCounts::counter_count; counter++) {
+            if (perf.is_available(counter)) {
+                out.repeat(' ', 4) << FixedPoint{perf[counter] / iterations, 3} << " " << names[counter] << " per iteration" << '\n';
+            }
+        }
+        if (perf.is_available(0) && perf.is_available(1)) {
+            out.repeat(' ', 4) << FixedPoint{perf.ipc(), 3} << " instructions per cycle" << '\n';
+        }
+    }
+}
+
+// Print throughput of a concurrent test case, each round calls the body once on every thread
+void print_stress(const StressStatistics &statistics, OutputBuffer &out) {
+    char text[48];
+    out << "STRESS:" << '\n';
+    out.repeat(' ', 4) << statistics.threads << " threads, " << statistics.rounds << " rounds in " << std::string_view(text, format_duration(statistics.wall, text)) << '\n';
+    // Call rates are timed over the body only, the total adds the rates of the threads as they run at once
+    double total = 0;
+    for (size_t thread = 0; thread < statistics.threads; thread++) {
+        int64_t busy = statistics.busy[thread];
+        double rate = busy > 0 ? statistics.rounds * 1e9 / busy : 0;
+        total += rate;
+        out.repeat(' ', 4) << "thread " << thread << ": " << FixedPoint{rate, 0} << " calls per second in the body" << '\n';
+    }
+    out.repeat(' ', 4) << "total:    " << FixedPoint{total, 0} << " calls per second in the body" << '\n';
+    // Rounds are timed over the wall time, which includes starting threads and waiting at the barriers between rounds
+    out.repeat(' ', 4) << "rounds:   " << FixedPoint{statistics.wall > 0 ? statistics.rounds * 1e9 / statistics.wall : 0, 0} << " per second including barrier waits" << '\n';
+}
+
+// Print test cases that have become slower or faster than their baseline
+void print_baseline_comparison(OutputBuffer &out) {
+    out << '\n';
+    out.repeat('=', separator_length) << '\n';
+    out << "baseline comparison ( " << machine_name << ", max regression " << FixedPoint{max_regression * 100, 1} << "% )" << '\n';
+    char text[48];
+    for (BaselineChange change : {BaselineChange::REGRESSION, BaselineChange::IMPROVEMENT}) {
+        out << (change == BaselineChange::REGRESSION ? "regressions:" : "improvements:") << '\n';
+        size_t count = 0;
+        for (size_t i = 0; i < reports.size(); i++) {
+            const TestReport &report = reports[i];
+            if (report.baseline_change != change) {
+                continue;
+            }
+            out.repeat(' ', 4) << tests[i]->test_name << "  ";
+            out << std::string_view(text, format_duration((int64_t)report.baseline_median, text)) << " -> ";
+            out << std::string_view(text, format_duration((int64_t)report.durations.median, text));
+            double percent = (report.durations.median / report.baseline_median - 1) * 100;
+            out << " ( " << (percent >= 0 ? "+" : "") << FixedPoint{percent, 1} << "% )" << '\n';
+            count++;
+        }
+        if (count == 0) {
+            out.repeat(' ', 4) << "none" << '\n';
+        }
+    }
+    size_t unchanged = 0;
+    size_t missing = 0;
+    for (const TestReport &report : reports) {
+        unchanged += report.baseline_change == BaselineChange::UNCHANGED;
+        missing += report.baseline_change == BaselineChange::MISSING;
+    }
+    out << unchanged << " unchanged, " << missing << " not in baseline" << '\n';
+}
+
+// Return if a test case has failed
+bool has_failed(const TestReport &report) {
+    return report.result.assertions_failed > 0 || report.crashed || (check_leaks && report.result.allocations.live_bytes > 0) ||
+           report.baseline_change == BaselineChange::REGRESSION;
+}
+
+void print_durations(OutputBuffer &out);
+void print_repeat_summary(OutputBuffer &out);
+
+// Human readable output
+// Test cases are only printed if they fail, unless -s is given or they are benchmarks
+class ConsoleReporter : public Reporter {
+   public:
+    void run_started(OutputBuffer &out, size_t) override {
+        out << '\n';
+    }
+
+    void test_started(TestOutput &output) override {
+        if (show_successful || output.test.benchmark || get_stress_threads(output.test) > 0) {
+            write_header(output);
+        }
+    }
+
+    void assertion(TestOutput &output, const Assertion &assertion) override {
+        write_header(output);
+        print_assertion(assertion, output.out);
+    }
+
+    void failure(TestOutput &output, const std::string &message) override {
+        write_header(output);
+        output.out << "FAILED:" << '\n';
+        output.out.repeat(' ', 4) << message << '\n';
+    }
+
+    void test_ended(TestOutput &output, const TestReport &report) override {
+        if (report.result.assertions_dropped > 0) {
+            write_header(output);
+            output.out << "( " << report.result.assertions_dropped << " more assertions not shown )" << '\n';
+        }
+        if (report.benchmark.samples > 0) {
+            print_benchmark(report.benchmark, output.out);
+        }
+        if (report.stress.threads > 0) {
+            print_stress(report.stress, output.out);
+        }
+    }
+
+    void run_ended(OutputBuffer &out, const RunTotals &totals) override {
+        if (compare_baseline) {
+            print_baseline_comparison(out);
+        }
+        if (!histories.empty()) {
+            print_repeat_summary(out);
+        }
+        print_results(totals, out);
+        if (show_durations) {
+            print_durations(out);
+        }
+    }
+
+   private:
+    void write_header(TestOutput &output) {
+        if (!output.header_written) {
+            print_test(output.test, output.out);
+            output.header_written = true;
+        }
+    }
+};
+
+// Write text escaped for use in XML attributes
+void escape_xml(OutputBuffer &out, std::string_view text) {
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        const char *escaped;
+        switch (text[i]) {
+            case '&':
+                escaped = "&amp;";
+                break;
+            case '<':
+                escaped = "&lt;";
+                break;
+            case '>':
+                escaped = "&gt;";
+                break;
+            case '"':
+                escaped = "&quot;";
+                break;
+            case '\n':
+                escaped = "&#10;";
+                break;
+            default:
+                // Other control characters are not allowed in XML 1.0
+                escaped = ((unsigned char)text[i] < 0x20 && text[i] != '\t') ? "" : nullptr;
+                break;
+        }
+        if (escaped != nullptr) {
+            out << text.substr(start, i - start) << escaped;
+            start = i + 1;
+        }
+    }
+    out << text.substr(start);
+}
+
+// Write text escaped for use in a JSON string
+void escape_json(OutputBuffer &out, std::string_view text) {
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out << text.substr(start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default: {
+                const char hex[] = "0123456789abcdef";
+                out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+                break;
+            }
+        }
+    }
+    out << text.substr(start);
+}
+
+// Write text as a quoted JSON string
+inline void write_json(OutputBuffer &out, std::string_view text) {
+    out << '"';
+    escape_json(out, text);
+    out << '"';
+}
+
+// JUnit XML, a test case element is written once the test case has ended
+// Closing elements are written at the end of the run, so a killed run leaves every ended test case behind
+class JUnitReporter : public Reporter {
+   public:
+    void run_started(OutputBuffer &out, size_t) override {
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << '\n';
+        out << "<testsuites>" << '\n';
+        out << "  <testsuite name=\"coretest\">" << '\n';
+    }
+
+    void test_started(TestOutput &) override {}
+
+    void assertion(TestOutput &output, const Assertion &assertion) override {
+        OutputBuffer &pending = output.pending;
+        if (assertion.passed) {
+            pending << "      <system-out>PASSED: ";
+            write_assertion(assertion, [&](std::string_view text) { escape_xml(pending, text); });
+            pending << "</system-out>" << '\n';
+        } else {
+            pending << "      <failure message=\"";
+            write_assertion(assertion, [&](std::string_view text) { escape_xml(pending, text); });
+            pending << "\" type=\"" << (assertion.type == AssertionType::REQUIRE ? "REQUIRE" : "CHECK") << "\"/>" << '\n';
+        }
+    }
+
+    void failure(TestOutput &output, const std::string &message) override {
+        output.pending << "      <failure message=\"";
+        escape_xml(output.pending, message);
+        output.pending << "\" type=\"error\"/>" << '\n';
+    }
+
+    void test_ended(TestOutput &output, const TestReport &report) override {
+        OutputBuffer &out = output.out;
+        out << "    <testcase name=\"";
+        escape_xml(out, output.test.test_name);
+        out << "\" classname=\"";
+        escape_xml(out, output.test.file_name);
+        out << "\" file=\"";
+        escape_xml(out, output.test.file_name);
+        out << "\" line=\"" << output.test.line_number << "\" assertions=\"" << report.result.assertions
+            << "\" time=\"" << FixedPoint{report.timing.wall * 1e-9, 6} << "\"";
+        if (output.pending.view().empty()) {
+            out << "/>" << '\n';
+            return;
+        }
+        out << ">" << '\n'
+            << output.pending.view() << "    </testcase>" << '\n';
+        output.pending.clear();
+    }
+
+    void run_ended(OutputBuffer &out, const RunTotals &totals) override {
+        out << "  </testsuite>" << '\n';
+        out << "  <!-- tests: " << totals.tests << ", failed: " << totals.tests_failed << ", assertions: " << totals.assertions << ", failed assertions: " << totals.assertions_failed << " -->" << '\n';
+        out << "</testsuites>" << '\n';
+    }
+};
+
+// JSON Lines, one object per event
+class JsonLinesReporter : public Reporter {
+   public:
+    void run_started(OutputBuffer &out, size_t test_count) override {
+        out << "{\"event\":\"run_start\",\"tests\":" << test_count << "}" << '\n';
+    }
+
+    void test_started(TestOutput &output) override {
+        const Test &test = output.test;
+        OutputBuffer &out = output.out;
+        out << "{\"event\":\"test_start\",\"index\":" << output.index << ",\"name\":";
+        write_json(out, test.test_name);
+        out << ",\"file\":";
+        write_json(out, test.file_name);
+        out << ",\"line\":" << test.line_number << ",\"tags\":";
+        write_json(out, test.tags);
+        out << "}" << '\n';
+    }
+
+    void assertion(TestOutput &output, const Assertion &assertion) override {
+        OutputBuffer &out = output.out;
+        out << "{\"event\":\"assertion\",\"index\":" << output.index << ",\"passed\":" << (assertion.passed ? "true" : "false") << ",\"assertion\":\"";
+        write_assertion(assertion, [&](std::string_view text) { escape_json(out, text); });
+        out << "\",\"first\":";
+        write_json(out, assertion.first);
+        out << ",\"second\":";
+        write_json(out, assertion.second);
+        out << "}" << '\n';
+    }
+
+    void failure(TestOutput &output, const std::string &message) override {
+        output.out << "{\"event\":\"failure\",\"index\":" << output.index << ",\"message\":";
+        write_json(output.out, message);
+        output.out << "}" << '\n';
+    }
+
+    void test_ended(TestOutput &output, const TestReport &report) override {
+        const TestResult &result = report.result;
+        OutputBuffer &out = output.out;
+        out << "{\"event\":\"test_end\",\"index\":" << output.index << ",\"name\":";
+        write_json(out, output.test.test_name);
+        out << ",\"passed\":" << (has_failed(report) ? "false" : "true") << ",\"assertions\":" << result.assertions
+            << ",\"assertions_failed\":" << result.assertions_failed << ",\"assertions_dropped\":" << result.assertions_dropped
+            << ",\"wall_ns\":" << report.timing.wall << ",\"user_ns\":" << report.timing.user << ",\"system_ns\":" << report.timing.system;
+        if (report.benchmark.samples > 0) {
+            const BenchmarkStatistics &benchmark = report.benchmark;
+            out << ",\"benchmark\":{\"samples\":" << benchmark.samples << ",\"iterations\":" << benchmark.iterations
+                << ",\"mean_ns\":" << FixedPoint{benchmark.mean, 3} << ",\"median_ns\":" << FixedPoint{benchmark.median, 3}
+                << ",\"stddev_ns\":" << FixedPoint{benchmark.stddev, 3} << ",\"min_ns\":" << FixedPoint{benchmark.min, 3} << "}";
+        }
+        if (report.stress.threads > 0) {
+            const StressStatistics &stress = report.stress;
+            out << ",\"stress\":{\"threads\":" << stress.threads << ",\"rounds\":" << stress.rounds << ",\"wall_ns\":" << stress.wall << ",\"busy_ns\":[";
+            for (size_t thread = 0; thread < stress.threads; thread++) {
+                out << (thread > 0 ? "," : "") << stress.busy[thread];
+            }
+            out << "]}";
+        }
+        out << "}" << '\n';
+    }
+
+    void run_ended(OutputBuffer &out, const RunTotals &totals) override {
+        // Repeated runs are summarized per test case
+        for (size_t i = 0; i < histories.size(); i++) {
+            const DurationHistogram &durations = histories[i].durations;
+            out << "{\"event\":\"test_summary\",\"index\":" << i << ",\"name\":";
+            write_json(out, tests[i]->test_name);
+            out << ",\"runs\":" << durations.get_count() << ",\"failed\":" << histories[i].failures << ",\"p50_ns\":" << durations.get_percentile(0.5)
+                << ",\"p90_ns\":" << durations.get_percentile(0.9) << ",\"p99_ns\":" << durations.get_percentile(0.99)
+                << ",\"p999_ns\":" << durations.get_percentile(0.999) << ",\"max_ns\":" << durations.get_max() << "}" << '\n';
+        }
+        out << "{\"event\":\"run_end\",\"tests\":" << totals.tests << ",\"tests_failed\":" << totals.tests_failed
+            << ",\"assertions\":" << totals.assertions << ",\"assertions_failed\":" << totals.assertions_failed;
+        if (!histories.empty()) {
+            out << ",\"passes\":" << passes;
+        }
+        if (totals.tests_not_run > 0) {
+            out << ",\"tests_not_run\":" << totals.tests_not_run;
+        }
+        out << "}" << '\n';
+    }
+};
+
+// Test Anything Protocol, assertions are written as diagnostics before the result line of their test case
+class TapReporter : public Reporter {
+   public:
+    void run_started(OutputBuffer &out, size_t test_count) override {
+        out << "TAP version 13" << '\n';
+        out << "1.." << test_count << '\n';
+    }
+
+    void test_started(TestOutput &) override {}
+
+    void assertion(TestOutput &output, const Assertion &assertion) override {
+        output.out << (assertion.passed ? "# PASSED: " : "# FAILED: ");
+        write_assertion(assertion, [&](std::string_view text) { write_diagnostic(output.out, text); });
+        output.out << '\n';
+    }
+
+    void failure(TestOutput &output, const std::string &message) override {
+        output.out << "# FAILED: ";
+        write_diagnostic(output.out, message);
+        output.out << '\n';
+    }
+
+    void test_ended(TestOutput &output, const TestReport &report) override {
+        if (report.result.assertions_dropped > 0) {
+            output.out << "# ( " << report.result.assertions_dropped << " more assertions not shown )" << '\n';
+        }
+        output.out << (has_failed(report) ? "not ok " : "ok ") << output.index + 1 << " - " << output.test.test_name << '\n';
+    }
+
+    void run_ended(OutputBuffer &out, const RunTotals &totals) override {
+        out << "# test cases: " << totals.tests << ", failed: " << totals.tests_failed << '\n';
+        out << "# assertions: " << totals.assertions << ", failed: " << totals.assertions_failed << '\n';
+        if (totals.tests_not_run > 0) {
+            // The plan announced more test cases than were run
+            out << "Bail out! stopped after " << max_failures << " failures" << '\n';
+        }
+    }
+
+   private:
+    // Every line of a diagnostic starts with #, so values holding newlines do not break the stream
+    void write_diagnostic(OutputBuffer &out, std::string_view text) {
+        size_t start = 0;
+        size_t newline;
+        while ((newline = text.find('\n', start)) != std::string_view::npos) {
+            out << text.substr(start, newline + 1 - start) << "# ";
+            start = newline + 1;
+        }
+        out << text.substr(start);
+    }
+};
+
+// Return reporter with name given with --reporter
+std::unique_ptr<Reporter> make_reporter(const std::string &name) {
+    if (name == "console") {
+        return std::unique_ptr<Reporter>(new ConsoleReporter());
+    } else if (name == "junit") {
+        return std::unique_ptr<Reporter>(new JUnitReporter());
+    } else if (name == "jsonl") {
+        return std::unique_ptr<Reporter>(new JsonLinesReporter());
+    } else if (name == "tap") {
+        return std::unique_ptr<Reporter>(new TapReporter());
+    }
+    raise_error("Unknown reporter: " + name + ", expected console, junit, jsonl or tap");
+}
+
+// Open performance counters of the current thread, the first failure is reported once
+bool open_perf_counters(TestContext &context) {
+    static std::once_flag warning_flag;
+    std::string error;
+    if (context.perf.open(error)) {
+        return true;
+    }
+    std::call_once(warning_flag, [&]() {
+        std::cerr << "coretest: hardware performance counters are unavailable (" << error << "), "
+                  << "check /proc/sys/kernel/perf_event_paranoid" << '\n';
+    });
+    return false;
+}
+
+// Compare sampled durations of a test case with its baseline, a regression is reported as a failure
+void compare_with_baseline(TestOutput &output, TestReport &report) {
+    const DurationStatistics *previous = baseline.find(machine_name, output.test.test_name);
+    if (previous == nullptr || previous->median <= 0) {
+        report.baseline_change = BaselineChange::MISSING;
+        return;
+    }
+    report.baseline_median = previous->median;
+    double change = report.durations.median / previous->median - 1;
+    if (!is_significant(report.durations, *previous) || std::fabs(change) <= max_regression) {
+        report.baseline_change = BaselineChange::UNCHANGED;
+    } else if (change > 0) {
+        report.baseline_change = BaselineChange::REGRESSION;
+        OutputBuffer message;
+        char text[48];
+        message << "median " << std::string_view(text, format_duration((int64_t)report.durations.median, text)) << " is " << FixedPoint{change * 100, 1}
+                << "% slower than baseline " << std::string_view(text, format_duration((int64_t)previous->median, text));
+        reporter->failure(output, std::string(message.view()));
+    } else {
+        report.baseline_change = BaselineChange::IMPROVEMENT;
+    }
+}
+
+// Concurrent test cases
+
+// Pin the calling thread to one of the cores it may run on, so that threads of a stress run do not migrate during it
+void pin_thread(size_t index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+    size_t position = index % (size_t)CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && position-- == 0) {
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+            return;
+        }
+    }
+#else
+    (void)index;
+#endif
+}
+
+// Releases all threads together once the last one has arrived
+// Threads spin so that they are released within nanoseconds of each other, and yield if the wait is long
+class SpinBarrier {
+   public:
+    explicit SpinBarrier(size_t new_count) : count(new_count) {}
+
+    void wait() {
+        size_t generation = current_generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+            arrived.store(0, std::memory_order_relaxed);
+            current_generation.store(generation + 1, std::memory_order_release);
+            return;
+        }
+        for (size_t spins = 0; current_generation.load(std::memory_order_acquire) == generation; spins++) {
+            if (spins < max_spins) {
+#if defined(CORETEST_HAS_X86_SIMD)
+                _mm_pause();
+#endif
+            } else {
+                // More threads than cores, the last thread needs a core to arrive
+                std::this_thread::yield();
+            }
+        }
+    }
+
+   private:
+    static const size_t max_spins = 4096;
+    const size_t count;
+    std::atomic<size_t> arrived{0};
+    std::atomic<size_t> current_generation{0};
+};
+
+// Run body of test case on thread_count pinned threads for rounds, each round releases all threads together
+// Rounds stop after --stress-rounds, or once --stress-time has passed, or after a round with a failed assertion
+StressStatistics run_stress(const Test &test, size_t thread_count) {
+    StressStatistics statistics;
+    statistics.threads = thread_count;
+    statistics.busy.assign(thread_count, 0);
+    SpinBarrier barrier(thread_count);
+    std::atomic<bool> stop{false};
+    std::atomic<bool> failed{false};
+    // Assertions of the stress threads belong to this run even while other test cases are running
+    const uint64_t run = current_context->run;
+    const int64_t start = get_steady_time();
+    auto run_thread = [&](size_t index) {
+        pin_thread(index);
+        stress_thread_index = (int)index;
+        thread_run = run;
+        while (true) {
+            barrier.wait();
+            if (stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+            size_t assertions_failed = thread_assertions_failed;
+            int64_t round_start = get_steady_time();
+            run_until_failed_require(test.function);
+            statistics.busy[index] += get_steady_time() - round_start;
+            if (thread_assertions_failed != assertions_failed) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+            barrier.wait();
+            if (index == 0) {
+                statistics.rounds++;
+                bool done = stress_time > 0 ? get_steady_time() - start >= stress_time * 1000000 : statistics.rounds >= stress_rounds;
+                stop.store(done || failed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+        stress_thread_index = -1;
+        thread_run = 0;
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (size_t index = 0; index < thread_count; index++) {
+        threads.emplace_back(run_thread, index);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    statistics.wall = get_steady_time() - start;
+    return statistics;
+}
+
+// Run a single test case on the current thread, reporting its events to out as they happen
+void run_test(const Test &test, size_t index, TestReport &report, OutputBuffer &out) {
+    TestContext &context = *current_context;
+    TestRunScope running(context);
+    report.ran = true;
+    context.result = TestResult();
+    context.count_passed_inline = !show_successful;
+    context.remote_frees.store(0, std::memory_order_relaxed);
+    context.remote_freed_bytes.store(0, std::memory_order_relaxed);
+    context.assertions_run.store(0, std::memory_order_relaxed);
+    clear_last_logged(context);
+    context.log.clear(assertion_log_limit);
+    TestOutput output(out, test, index);
+    reporter->test_started(output);
+    out.flush();
+    context.output = &output;
+    bool count_perf = use_perf_counters && open_perf_counters(context);
+    size_t thread_count = get_stress_threads(test);
+    run_until_failed_require([&] {
+        Timer timer(report.timing);
+        WatchScope watch(test);
+        if (count_perf) {
+            context.perf.start();
+        }
+        // Only calls of the body are counted, benchmarks count their timed iterations,
+        // and bodies of concurrent test cases run on threads whose allocations are not counted
+        if (test.benchmark) {
+            report.benchmark = measure_benchmark(test.function);
+        } else if (thread_count > 0) {
+            report.stress = run_stress(test, thread_count);
+        } else {
+            CountAllocations counting(context);
+            test.function();
+        }
+    });
+    context.result.assertions += context.assertions_run.exchange(0, std::memory_order_relaxed);
+    merge_thread_assertions(context);
+    // Threads started by the test case have been joined, so their frees of its blocks have been counted
+    context.result.allocations.frees += context.remote_frees.exchange(0, std::memory_order_relaxed);
+    context.result.allocations.live_bytes -= context.remote_freed_bytes.exchange(0, std::memory_order_relaxed);
+    context.output = nullptr;
+    if (count_perf) {
+        context.perf.stop();
+        context.result.perf = context.perf.read();
+    }
+    report.result = context.result;
+    if (check_leaks && report.result.allocations.live_bytes > 0) {
+        reporter->failure(output, "test case leaked " + std::to_string(report.result.allocations.live_bytes) + " bytes");
+    }
+    if ((save_baseline || compare_baseline) && !has_failed(report)) {
+        if (test.benchmark) {
+            // Benchmarks are compared per iteration
+            const BenchmarkStatistics &benchmark = report.benchmark;
+            report.durations.samples = benchmark.samples;
+            report.durations.median = benchmark.median;
+            report.durations.deviation = benchmark.stddev;
+            report.durations.min = benchmark.min;
+        } else if (thread_count > 0) {
+            // Concurrent test cases are compared per round
+            const StressStatistics &stress = report.stress;
+            report.durations.samples = stress.rounds;
+            report.durations.median = (double)stress.wall / stress.rounds;
+            report.durations.min = report.durations.median;
+        } else {
+            report.durations = sample_durations(test, report.timing.wall);
+        }
+        if (compare_baseline) {
+            compare_with_baseline(output, report);
+        }
+    }
+    if (has_failed(report)) {
+        failed_runs.fetch_add(1, std::memory_order_relaxed);
+    }
+    reporter->test_ended(output, report);
+    out.flush();
+}
+
+// Return timeout of a test case in milliseconds, 0 if it has none
+inline int64_t get_timeout(const Test &test) {
+    return test.timeout > 0 ? test.timeout : timeout;
+}
+
+// Format the last logged assertion of context into text, returns false if none was logged or it kept changing
+// The sequence number is checked again after reading the views, so views of different assertions are never followed,
+// and after copying them, so that text overwritten by a test case that has since ended is discarded
+bool read_last_logged(const TestContext &context, std::string &text) {
+    for (int attempt = 0; attempt < 100; attempt++) {
+        uint64_t sequence = context.last_logged_sequence.load(std::memory_order_acquire);
+        if (sequence % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t fields = context.last_logged_fields.load(std::memory_order_acquire);
+        std::string_view first_view(context.last_first.load(std::memory_order_acquire), context.last_first_size.load(std::memory_order_acquire));
+        std::string_view second_view(context.last_second.load(std::memory_order_acquire), context.last_second_size.load(std::memory_order_acquire));
+        // Views are only followed once they are known to belong to the same assertion
+        if (context.last_logged_sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        if ((fields & 4) == 0) {
+            return false;
+        }
+        std::string first(first_view);
+        std::string second(second_view);
+        if (context.last_logged_sequence.load(std::memory_order_acquire) != sequence) {
+            continue;
+        }
+        Assertion assertion = {(fields & 1) != 0, (AssertionType)((fields >> 8) & 0xff), (ComparisonType)((fields >> 16) & 0xff), first, second, (fields & 2) != 0, (int)(uint32_t)(fields >> 32) - 1};
+        text.clear();
+        write_assertion(assertion, [&](std::string_view piece) { text += piece; });
+        return true;
+    }
+    return false;
+}
+
+// Report a test case that has run past its timeout to standard error and abort the run
+// Runs on the watchdog thread, so it only reads state the test case publishes and leaves its log and output alone
+[[noreturn]] void report_timeout(const WatchdogSlot &slot) {
+    const Test &test = *slot.test.load();
+    TestContext &context = *slot.context;
+    std::string message = std::string("coretest: ") + test.test_name + ": test case timed out after " + std::to_string(get_timeout(test)) + " ms ( " + std::to_string(context.assertions_run.load(std::memory_order_acquire)) + " assertions run";
+    std::string last_logged;
+    if (read_last_logged(context, last_logged)) {
+        message += ", last logged " + last_logged;
+    }
+    message += " ), aborting\n";
+    std::fwrite(message.data(), 1, message.size(), stderr);
+    std::fflush(stderr);
+    std::abort();
+}
+
+// Aborts the run if a test case runs longer than its timeout
+// Runner threads publish the test case they run in a slot, which the watchdog thread polls
+class Watchdog {
+   public:
+    void start(size_t slot_count, std::chrono::milliseconds new_interval) {
+        slots.reset(new WatchdogSlot[slot_count]);
+        count = slot_count;
+        interval = new_interval;
+        stopping = false;
+        thread = std::thread(&Watchdog::run, this);
+    }
+
+    void stop() {
+        if (!thread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+    }
+
+    inline bool is_running() const {
+        return thread.joinable();
+    }
+
+    inline WatchdogSlot &get_slot(size_t index) {
+        return slots[index];
+    }
+
+   private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!condition.wait_for(lock, interval, [this]() { return stopping; })) {
+            int64_t now = get_steady_time();
+            for (size_t i = 0; i < count; i++) {
+                WatchdogSlot &slot = slots[i];
+                int64_t start = slot.start.load(std::memory_order_acquire);
+                const Test *test = slot.test.load(std::memory_order_relaxed);
+                if (start == 0 || test == nullptr || get_timeout(*test) == 0) {
+                    continue;
+                }
+                int64_t elapsed = now - start;
+                // Test case is still the one that started at start
+                if (elapsed > get_timeout(*test) * 1000000 && slot.start.load(std::memory_order_acquire) == start) {
+                    report_timeout(slot);
+                }
+            }
+        }
+    }
+
+    std::unique_ptr<WatchdogSlot[]> slots;
+    size_t count = 0;
+    std::chrono::milliseconds interval;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+Watchdog watchdog;
+
+// Return interval at which the watchdog polls for the timeouts of tests, 0 if no test case has a timeout
+std::chrono::milliseconds get_watchdog_interval() {
+    int64_t shortest = 0;
+    for (const Test *test : tests) {
+        int64_t test_timeout = get_timeout(*test);
+        if (test_timeout > 0 && (shortest == 0 || test_timeout < shortest)) {
+            shortest = test_timeout;
+        }
+    }
+    if (shortest == 0) {
+        return std::chrono::milliseconds(0);
+    }
+    // Timeouts are detected at most a quarter late, polling at most every 100 ms
+    return std::chrono::milliseconds(std::max<int64_t>(1, std::min<int64_t>(100, shortest / 4)));
+}
+
+// Deque of test indices owned by a worker
+// The owner takes indices from the front, idle workers steal from the back
+class WorkQueue {
+   public:
+    void push(size_t index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        indices.push_back(index);
+    }
+
+    bool pop(size_t &index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (indices.empty()) {
+            return false;
+        }
+        index = indices.front();
+        indices.pop_front();
+        return true;
+    }
+
+    bool steal(size_t &index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (indices.empty()) {
+            return false;
+        }
+        index = indices.back();
+        indices.pop_back();
+        return true;
+    }
+
+   private:
+    std::mutex mutex;
+    std::deque<size_t> indices;
+};
+
+// Contexts of worker threads, reused by later runs and never deleted,
+// as counted allocations refer to the context of their test case until they are freed, which may be after the run
+std::vector<TestContext *> worker_contexts;
+
+// Run test cases from own queue, then steal from other workers until all queues are empty
+void run_worker(size_t worker, std::vector<WorkQueue> &queues, std::vector<TestReport> &reports) {
+    TestContext &context = *worker_contexts[worker];
+    current_context = &context;
+    if (watchdog.is_running()) {
+        // Slot 0 is used by the main thread
+        current_slot = &watchdog.get_slot(worker + 1);
+        current_slot->context = &context;
+    }
+    size_t index;
+    while (true) {
+        bool found = queues[worker].pop(index);
+        for (size_t i = 1; !found && i < queues.size(); i++) {
+            found = queues[(worker + i) % queues.size()].steal(index);
+        }
+        if (!found || reached_max_failures()) {
+            break;
+        }
+        OutputBuffer out;
+        run_test(*tests[index], index, reports[index], out);
+        reports[index].output = out.view();
+    }
+    current_context = &foreign_context;
+    current_slot = nullptr;
+}
+
+// Run test cases on a pool of jobs threads
+// Test cases marked as serial run on the main thread once the pool has finished
+void run_parallel(std::vector<TestReport> &reports) {
+    std::vector<size_t> parallel_indices;
+    std::vector<size_t> serial_indices;
+    for (size_t i = 0; i < tests.size(); i++) {
+        if (is_serial(*tests[i])) {
+            serial_indices.push_back(i);
+        } else {
+            parallel_indices.push_back(i);
+        }
+    }
+    size_t worker_count = std::max((size_t)1, std::min(jobs, parallel_indices.size()));
+    std::vector<WorkQueue> queues(worker_count);
+    // Give each worker a contiguous block of test cases
+    for (size_t i = 0; i < parallel_indices.size(); i++) {
+        queues[i * worker_count / parallel_indices.size()].push(parallel_indices[i]);
+    }
+    while (worker_contexts.size() < worker_count) {
+        worker_contexts.push_back(new TestContext());
+    }
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < worker_count; worker++) {
+        workers.emplace_back(run_worker, worker, std::ref(queues), std::ref(reports));
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (size_t index : serial_indices) {
+        if (reached_max_failures()) {
+            break;
+        }
+        OutputBuffer out;
+        run_test(*tests[index], index, reports[index], out);
+        reports[index].output = out.view();
+    }
+}
+
+#if defined(CORETEST_HAS_FORK)
+// Single producer, single consumer byte ring in memory shared between a worker process and the supervisor
+struct WorkerChannel {
+    static const size_t ring_size = 64 * 1024;
+
+    // Index of the test case the worker is running, -1 if none
+    std::atomic<long> current_test;
+    // Steady time the current test case started at
+    std::atomic<int64_t> current_start;
+    // Bytes written by the worker
+    std::atomic<size_t> head;
+    // Bytes read by the supervisor
+    std::atomic<size_t> tail;
+    char ring[ring_size];
+
+    void reset() {
+        current_test.store(-1);
+        current_start.store(0);
+        head.store(0);
+        tail.store(0);
+    }
+
+    // Called by the worker, waits while the ring is full
+    void write(const char *data, size_t size) {
+        while (size > 0) {
+            size_t write_head = head.load(std::memory_order_relaxed);
+            size_t space = ring_size - (write_head - tail.load(std::memory_order_acquire));
+            if (space == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            size_t count = std::min(size, space);
+            for (size_t i = 0; i < count; i++) {
+                ring[(write_head + i) % ring_size] = data[i];
+            }
+            head.store(write_head + count, std::memory_order_release);
+            data += count;
+            size -= count;
+        }
+    }
+
+    // Called by the supervisor, appends available bytes to buffer
+    bool read(std::string &buffer) {
+        size_t read_tail = tail.load(std::memory_order_relaxed);
+        size_t read_head = head.load(std::memory_order_acquire);
+        for (size_t i = read_tail; i < read_head; i++) {
+            buffer.push_back(ring[i % ring_size]);
+        }
+        tail.store(read_head, std::memory_order_release);
+        return read_head != read_tail;
+    }
+};
+
+// Fixed size part of a test case report sent over a WorkerChannel
+// Followed by the busy time of each of the stress_threads threads and then output_size bytes of output
+struct ReportHeader {
+    size_t index;
+    TestResult result;
+    TestTiming timing;
+    BenchmarkStatistics benchmark;
+    DurationStatistics durations;
+    BaselineChange baseline_change;
+    double baseline_median;
+    size_t stress_threads;
+    size_t stress_rounds;
+    int64_t stress_wall;
+    size_t output_size;
+};
+
+// Return name of signal that terminated a worker
+std::string get_signal_name(int signal_number) {
+    switch (signal_number) {
+        case SIGSEGV:
+            return "SIGSEGV";
+        case SIGABRT:
+            return "SIGABRT";
+        case SIGFPE:
+            return "SIGFPE";
+        case SIGBUS:
+            return "SIGBUS";
+        case SIGILL:
+            return "SIGILL";
+        case SIGKILL:
+            return "SIGKILL";
+        case SIGTERM:
+            return "SIGTERM";
+        default:
+            return "signal " + std::to_string(signal_number);
+    }
+}
+
+// Worker process, takes test cases from the shared queue until it is empty
+[[noreturn]] void run_isolated_worker(const std::vector<size_t> &indices, std::atomic<size_t> &next, WorkerChannel &channel) {
+    while (true) {
+        size_t position = next.fetch_add(1);
+        if (position >= indices.size()) {
+            break;
+        }
+        size_t index = indices[position];
+        channel.current_start.store(get_steady_time());
+        channel.current_test.store((long)index);
+        TestReport report;
+        OutputBuffer out;
+        run_test(*tests[index], index, report, out);
+        std::cout.flush();
+        std::string_view output = out.view();
+        const StressStatistics &stress = report.stress;
+        ReportHeader header = {index, report.result, report.timing, report.benchmark, report.durations, report.baseline_change, report.baseline_median, stress.threads, stress.rounds, stress.wall, output.size()};
+        channel.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        channel.write(reinterpret_cast<const char *>(stress.busy.data()), stress.busy.size() * sizeof(int64_t));
+        channel.write(output.data(), output.size());
+        channel.current_test.store(-1);
+    }
+    std::cout.flush();
+    _exit(0);
+}
+
+// Move complete reports received from a worker into reports
+void receive_reports(std::string &buffer, std::vector<TestReport> &reports, std::vector<bool> &received) {
+    size_t offset = 0;
+    while (buffer.size() - offset >= sizeof(ReportHeader)) {
+        ReportHeader header;
+        std::memcpy(&header, buffer.data() + offset, sizeof(header));
+        size_t busy_size = header.stress_threads * sizeof(int64_t);
+        if (buffer.size() - offset - sizeof(header) < busy_size + header.output_size) {
+            // Rest of report has not fully arrived
+            break;
+        }
+        TestReport &report = reports[header.index];
+        report.result = header.result;
+        report.timing = header.timing;
+        report.benchmark = header.benchmark;
+        report.durations = header.durations;
+        report.baseline_change = header.baseline_change;
+        report.baseline_median = header.baseline_median;
+        report.stress.threads = header.stress_threads;
+        report.stress.rounds = header.stress_rounds;
+        report.stress.wall = header.stress_wall;
+        report.stress.busy.resize(header.stress_threads);
+        if (busy_size > 0) {
+            std::memcpy(report.stress.busy.data(), buffer.data() + offset + sizeof(header), busy_size);
+        }
+        report.output = buffer.substr(offset + sizeof(header) + busy_size, header.output_size);
+        report.ran = true;
+        if (has_failed(report)) {
+            failed_runs.fetch_add(1, std::memory_order_relaxed);
+        }
+        received[header.index] = true;
+        offset += sizeof(header) + busy_size + header.output_size;
+    }
+    buffer.erase(0, offset);
+}
+
+// Run test cases at indices on worker_count forked worker processes
+// A worker that dies has its current test case marked as failed and is replaced by a new worker
+void run_isolated(const std::vector<size_t> &indices, size_t worker_count, std::vector<TestReport> &reports) {
+    if (indices.empty()) {
+        return;
+    }
+    worker_count = std::max((size_t)1, std::min(worker_count, indices.size()));
+    size_t shared_size = sizeof(std::atomic<size_t>) + worker_count * sizeof(WorkerChannel);
+    void *shared = mmap(nullptr, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        raise_error("Failed to map shared memory for --isolate");
+    }
+    std::atomic<size_t> *next = new (shared) std::atomic<size_t>(0);
+    WorkerChannel *channels = reinterpret_cast<WorkerChannel *>(static_cast<char *>(shared) + sizeof(std::atomic<size_t>));
+    std::vector<pid_t> pids(worker_count, -1);
+    std::vector<std::string> buffers(worker_count);
+    std::vector<bool> received(reports.size(), false);
+    // Worker was killed because its test case timed out
+    std::vector<bool> timed_out(worker_count, false);
+    // Flush before forking so that buffered output is not written by every worker
+    std::cout.flush();
+    report_output.flush();
+    auto spawn = [&](size_t worker) {
+        channels[worker].reset();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_isolated_worker(indices, *next, channels[worker]);
+        }
+        if (pid < 0) {
+            raise_error("Failed to fork worker process for --isolate");
+        }
+        pids[worker] = pid;
+        timed_out[worker] = false;
+    };
+    for (size_t worker = 0; worker < worker_count; worker++) {
+        new (&channels[worker]) WorkerChannel();
+        spawn(worker);
+    }
+    size_t running = worker_count;
+    while (running > 0) {
+        bool has_progress = false;
+        for (size_t worker = 0; worker < worker_count; worker++) {
+            if (pids[worker] != -1 && channels[worker].read(buffers[worker])) {
+                receive_reports(buffers[worker], reports, received);
+                has_progress = true;
+            }
+        }
+        int64_t now = get_steady_time();
+        for (size_t worker = 0; worker < worker_count; worker++) {
+            long index = channels[worker].current_test.load();
+            if (pids[worker] == -1 || timed_out[worker] || index < 0) {
+                continue;
+            }
+            int64_t test_timeout = get_timeout(*tests[index]);
+            // Start is read after the index, so a worker that has moved to the next test case is not killed
+            if (test_timeout > 0 && now - channels[worker].current_start.load() > test_timeout * 1000000) {
+                kill(pids[worker], SIGKILL);
+                timed_out[worker] = true;
+            }
+        }
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0) {
+            has_progress = true;
+            size_t worker = std::find(pids.begin(), pids.end(), pid) - pids.begin();
+            if (worker == worker_count) {
+                // Not one of our workers
+                continue;
+            }
+            // Receive reports written before the worker ended
+            channels[worker].read(buffers[worker]);
+            receive_reports(buffers[worker], reports, received);
+            buffers[worker].clear();
+            long index = channels[worker].current_test.load();
+            pids[worker] = -1;
+            running--;
+            if (index >= 0 && !received[index]) {
+                // Worker ended in the middle of a test case
+                TestReport &report = reports[index];
+                report.crashed = true;
+                report.ran = true;
+                failed_runs.fetch_add(1, std::memory_order_relaxed);
+                OutputBuffer out;
+                TestOutput output(out, *tests[index], index);
+                reporter->test_started(output);
+                if (timed_out[worker]) {
+                    reporter->failure(output, "test case timed out after " + std::to_string(get_timeout(*tests[index])) + " ms");
+                } else if (WIFSIGNALED(status)) {
+                    reporter->failure(output, "test case terminated by " + get_signal_name(WTERMSIG(status)));
+                } else {
+                    reporter->failure(output, "test case exited with status " + std::to_string(WEXITSTATUS(status)));
+                }
+                reporter->test_ended(output, report);
+                report.output = out.view();
+                received[index] = true;
+                if (next->load() < indices.size()) {
+                    // Replace worker while test cases remain
+                    spawn(worker);
+                    running++;
+                }
+            }
+        }
+        if (reached_max_failures()) {
+            // Workers take no more test cases and end after their current one
+            next->store(indices.size());
+        }
+        if (!has_progress) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    munmap(shared, shared_size);
+}
+#endif
+
+// Return map from name to registered test case
+std::unordered_map<std::string_view, const Test *> build_test_index() {
+    std::unordered_map<std::string_view, const Test *> index;
+    index.reserve(registry.size);
+    for (const Test *test = registry.first; test != nullptr; test = test->next) {
+        // First test case registered with a name is used
+        index.emplace(test->test_name, test);
+    }
+    return index;
+}
+
+// Return if another pass over the selected test cases is run after a pass
+// --repeat limits the number of passes, --soak their duration, and --until-fail stops after a failed pass
+bool run_another_pass(bool pass_failed) {
+    if (!is_repeating() || reached_max_failures() || (until_fail && pass_failed) || (set_repeat && passes >= repeat_count)) {
+        return false;
+    }
+    return soak_duration == 0 || passes_wall < soak_duration;
+}
+
+// Shuffle test cases with a generator seeded by --order random:<seed>, so that an order can be reproduced
+// std::shuffle is not used as its result differs between standard libraries
+void shuffle_tests(uint64_t seed) {
+    std::mt19937_64 generator(seed);
+    for (size_t i = tests.size(); i > 1; i--) {
+        std::swap(tests[i - 1], tests[generator() % i]);
+    }
+}
+
+// Order selected test cases by --rerun-failed, --order and --failed-first using the run-state file
+void schedule_tests() {
+    auto previously_failed = [](const Test *test) {
+        const TestState *state = run_state.find(test->test_name);
+        return state != nullptr && state->failed;
+    };
+    if (rerun_failed) {
+        tests.erase(std::remove_if(tests.begin(), tests.end(), [&](const Test *test) { return !previously_failed(test); }), tests.end());
+    }
+    if (test_order == "slowest-first" || test_order == "fastest-first") {
+        bool slowest_first = test_order == "slowest-first";
+        // Test cases without a recorded duration are new and run first
+        auto duration = [](const Test *test) {
+            const TestState *state = run_state.find(test->test_name);
+            return state == nullptr ? (int64_t)-1 : state->duration;
+        };
+        std::stable_sort(tests.begin(), tests.end(), [&](const Test *a, const Test *b) {
+            int64_t a_duration = duration(a);
+            int64_t b_duration = duration(b);
+            if (a_duration < 0 || b_duration < 0) {
+                return a_duration < 0 && b_duration >= 0;
+            }
+            return slowest_first ? a_duration > b_duration : a_duration < b_duration;
+        });
+    } else if (test_order.compare(0, 7, "random:") == 0) {
+        shuffle_tests(order_seed);
+    }
+    if (failed_first) {
+        std::stable_partition(tests.begin(), tests.end(), previously_failed);
+    }
+}
+
+// Keep the test cases of this shard, splitting the selected test cases over shard_count shards
+// Test cases are assigned longest first to the shard with the least total duration, which keeps shards within
+// the duration of one test case of each other. Test cases without a recorded duration count as the mean duration,
+// so without --shard-timings test cases are dealt out in declared order.
+// The assignment only depends on the selected test cases and the timings file, so every shard computes the same one.
+void shard_tests() {
+    if (shard_count <= 1) {
+        return;
+    }
+    std::vector<int64_t> durations(tests.size(), -1);
+    int64_t known_total = 0;
+    size_t known_count = 0;
+    for (size_t i = 0; i < tests.size(); i++) {
+        const TestState *state = shard_timings.find(tests[i]->test_name);
+        if (state != nullptr) {
+            durations[i] = state->duration;
+            known_total += state->duration;
+            known_count++;
+        }
+    }
+    int64_t mean = known_count > 0 ? std::max(known_total / (int64_t)known_count, (int64_t)1) : 1;
+    std::vector<size_t> order(tests.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+        if (durations[i] < 0) {
+            durations[i] = mean;
+        }
+    }
+    // Stable so that equal durations keep declared order
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return durations[a] > durations[b]; });
+    std::vector<int64_t> loads(shard_count, 0);
+    std::vector<bool> keep(tests.size(), false);
+    for (size_t i : order) {
+        // First shard with the least load, so ties are broken the same way on every shard
+        size_t shard = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        loads[shard] += durations[i];
+        keep[i] = shard == shard_index;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < tests.size(); i++) {
+        if (keep[i]) {
+            tests[kept++] = tests[i];
+        }
     }
+    tests.resize(kept);
 }
 
-// Run through tests
-void run_tests() {
-    std::cout << '\n';
-    int tests_failed = 0;
-    int assertions_failed = 0;
-    int initial_assertions = 0;
+// Fill tests with the test cases selected by name, --benchmark, filter and shard, in the order they are named or declared
+void select_tests() {
+    tests.clear();
     if (specified_tests.size() > 0) {
-        // User has supplied specific tests to run
-        std::vector<Test> new_tests;
-        for (std::string test_name : specified_tests) {
-            for (auto test : tests) {
-                if (test.test_name == test_name) {
-                    new_tests.push_back(test);
+        // User has supplied specific tests to run, look them up by name
+        std::unordered_map<std::string_view, const Test *> index = build_test_index();
+        for (const std::string &test_name : specified_tests) {
+            auto found = index.find(test_name);
+            if (found != index.end()) {
+                tests.push_back(found->second);
+            }
+        }
+    } else {
+        tests.reserve(registry.size);
+        for (const Test *test = registry.first; test != nullptr; test = test->next) {
+            tests.push_back(test);
+        }
+    }
+    // Benchmarks only run with --benchmark, test cases only run without it
+    tests.erase(std::remove_if(tests.begin(), tests.end(), [](const Test *test) { return test->benchmark != run_benchmarks || !test_filter.matches(*test); }), tests.end());
+    shard_tests();
+}
+
+// Add assertions of threads that no test case run owned to totals, and return whether any of them failed
+// These were made while no or several test cases were running, so they are printed on their own
+bool merge_unattributed(RunTotals &totals) {
+    TestResult result;
+    AssertionLog log;
+    log.clear(assertion_log_limit);
+    merge_unattributed_assertions(result, log);
+    totals.assertions += result.assertions;
+    totals.assertions_failed += result.assertions_failed;
+    totals.assertions_failed_unattributed += result.assertions_failed;
+    for (const Assertion &assertion : log.get_assertions()) {
+        std::cerr << "coretest: failed ";
+        write_assertion(assertion, [](std::string_view text) { std::cerr << text; });
+        std::cerr << " on a thread while no single test case was running, declare test cases starting threads with TEST_SERIAL" << '\n';
+    }
+    return result.assertions_failed > 0;
+}
+
+// Run through tests and return counts of the run
+RunTotals run_tests() {
+    select_tests();
+    schedule_tests();
+    reports.assign(tests.size(), TestReport());
+    reporter->run_started(report_output, tests.size());
+    report_output.flush();
+    std::chrono::milliseconds watchdog_interval = get_watchdog_interval();
+    if (!isolate && watchdog_interval.count() > 0) {
+        // Worker processes are watched by the supervisor instead
+        watchdog.start(jobs + 1, watchdog_interval);
+        current_slot = &watchdog.get_slot(0);
+        current_slot->context = &main_context;
+    }
+    RunTotals totals;
+    failed_runs.store(0);
+    // Test cases that have run and failed in any pass
+    std::vector<bool> ran(tests.size(), false);
+    std::vector<bool> failed(tests.size(), false);
+    // Duration of the last run of each test case
+    std::vector<int64_t> last_wall(tests.size(), 0);
+    histories.clear();
+    histories.resize(is_repeating() ? tests.size() : 0);
+    // Repeated test cases are reported once at the end, by their first failed run or else their last run
+    // Runs of a pass are held in pass_reports until then, so the output does not grow with the number of passes
+    const bool repeating = is_repeating();
+    std::vector<TestReport> pass_reports;
+    std::vector<TestReport> &current = repeating ? pass_reports : reports;
+    passes = 0;
+    int64_t start = get_steady_time();
+    bool pass_failed;
+    do {
+        if (repeating) {
+            pass_reports.assign(tests.size(), TestReport());
+        }
+        pass_failed = false;
+        if (isolate) {
+#if defined(CORETEST_HAS_FORK)
+            std::vector<size_t> parallel_indices;
+            std::vector<size_t> serial_indices;
+            for (size_t i = 0; i < tests.size(); i++) {
+                (is_serial(*tests[i]) ? serial_indices : parallel_indices).push_back(i);
+            }
+            run_isolated(parallel_indices, jobs, current);
+            run_isolated(serial_indices, 1, current);
+#else
+            raise_error("--isolate is not supported on this platform");
+#endif
+        } else if (jobs > 1) {
+            run_parallel(current);
+        }
+        for (size_t i = 0; i < tests.size(); i++) {
+            if (!isolate && jobs <= 1) {
+                if (reached_max_failures()) {
+                    break;
+                }
+                if (repeating) {
+                    OutputBuffer out;
+                    run_test(*tests[i], i, current[i], out);
+                    current[i].output = out.view();
+                } else {
+                    // Events of serial runs are written as they happen
+                    run_test(*tests[i], i, current[i], report_output);
+                }
+            } else if (!repeating) {
+                // Reports are written in scheduled order
+                report_output << current[i].output;
+                report_output.flush();
+            }
+            const TestReport &report = current[i];
+            if (!report.ran) {
+                continue;
+            }
+            ran[i] = true;
+            last_wall[i] = report.timing.wall;
+            bool test_failed = has_failed(report);
+            if (test_failed && !failed[i]) {
+                failed[i] = true;
+                totals.tests_failed++;
+            }
+            pass_failed = pass_failed || test_failed;
+            if (repeating) {
+                histories[i].durations.record(report.timing.wall);
+                histories[i].failures += test_failed;
+                if (!has_failed(reports[i])) {
+                    reports[i] = std::move(current[i]);
                 }
             }
         }
-        tests = new_tests;
+        if (merge_unattributed(totals)) {
+            pass_failed = true;
+        }
+        passes++;
+        passes_wall = get_steady_time() - start;
+    } while (run_another_pass(pass_failed));
+    // Totals count the reported run of each test case, the repeat summary counts the passes
+    for (size_t i = 0; i < tests.size(); i++) {
+        if (repeating) {
+            report_output << reports[i].output;
+        }
+        if (ran[i]) {
+            totals.tests++;
+            totals.assertions += reports[i].result.assertions;
+            totals.assertions_failed += reports[i].result.assertions_failed;
+            run_state.set(tests[i]->test_name, TestState{failed[i], last_wall[i]});
+        } else {
+            totals.tests_not_run++;
+        }
     }
-    for (auto test : tests) {
-        initial_assertions = assertions.size();
-        bool has_catch = false;
-        try {
-            Timer timer;
-            test.function();
-        } catch (CoreTestError &e) {
-            has_catch = true;
-            // Print test case
-            print_test(test);
-            // Print failed checks
-            print_assertions(initial_assertions, assertions_failed);
-            // Assertions failed increase by 1 to account for thrown error
-            tests_failed++;
+    watchdog.stop();
+    current_slot = nullptr;
+    reporter->run_ended(report_output, totals);
+    report_output.flush();
+    return totals;
+}
+
+// Write value of a column of the durations table to text, which must hold 48 characters, and return its length
+size_t format_duration_column(const TestReport &report, size_t column, char *text) {
+    if (column < 3) {
+        const int64_t times[] = {report.timing.wall, report.timing.user, report.timing.system};
+        return format_duration(times[column], text);
+    }
+    column -= 3;
+#if defined(CORETEST_COUNT_ALLOCATIONS)
+    if (column < 4) {
+        const AllocationCounters &allocations = report.result.allocations;
+        const int64_t values[] = {(int64_t)allocations.allocations, (int64_t)allocations.frees, (int64_t)allocations.bytes, allocations.peak_live_bytes};
+        return OutputBuffer::format_integer(values[column], text);
+    }
+    column -= 4;
+#endif
+    // Performance counters, those that could not be opened are shown as -
+    const PerfCounts &perf = report.result.perf;
+    const int counters[] = {0, 1, -1, 2, 3, 4};
+    if (counters[column] == -1 && perf.is_available(0) && perf.is_available(1)) {
+        return OutputBuffer::format_fixed(perf.ipc(), 2, text);
+    } else if (counters[column] != -1 && perf.is_available(counters[column])) {
+        return OutputBuffer::format_integer(perf[counters[column]], text);
+    }
+    text[0] = '-';
+    return 1;
+}
+
+void print_durations(OutputBuffer &out) {
+    out << '\n';
+    std::vector<const char *> headers = {"wall", "user", "system"};
+#if defined(CORETEST_COUNT_ALLOCATIONS)
+    headers.insert(headers.end(), {"allocs", "frees", "bytes", "peak"});
+#endif
+    if (use_perf_counters) {
+        headers.insert(headers.end(), {"cycles", "instructions", "IPC", "branch-misses", "L1D-misses", "LLC-misses"});
+    }
+    // Find longest entry of each column for alignment
+    char text[48];
+    std::vector<size_t> widths;
+    for (const char *header : headers) {
+        widths.push_back(std::strlen(header));
+    }
+    for (const TestReport &report : reports) {
+        for (size_t column = 0; column < headers.size(); column++) {
+            widths[column] = std::max(widths[column], format_duration_column(report, column, text));
+        }
+    }
+    for (size_t column = 0; column < headers.size(); column++) {
+        out.repeat(' ', widths[column] - std::strlen(headers[column])) << headers[column] << "  ";
+    }
+    out << "test case" << '\n';
+    for (size_t i = 0; i < reports.size(); i++) {
+        for (size_t column = 0; column < headers.size(); column++) {
+            size_t length = format_duration_column(reports[i], column, text);
+            out.repeat(' ', widths[column] - length) << std::string_view(text, length) << "  ";
+        }
+        out << tests[i]->test_name << '\n';
+    }
+}
+
+// Fractions of the durations of repeated runs printed by print_repeat_summary
+const double repeat_percentiles[] = {0.5, 0.9, 0.99, 0.999};
+
+// Write value of a column of the repeat summary to text, which must hold 48 characters, and return its length
+size_t format_repeat_column(const RepeatHistory &history, size_t column, char *text) {
+    if (column == 0) {
+        return OutputBuffer::format_integer(history.durations.get_count(), text);
+    } else if (column == 1) {
+        return OutputBuffer::format_integer(history.failures, text);
+    } else if (column < 6) {
+        return format_duration((int64_t)history.durations.get_percentile(repeat_percentiles[column - 2]), text);
+    }
+    return format_duration((int64_t)history.durations.get_max(), text);
+}
+
+// Print number of runs, failures and duration percentiles of each test case over all passes
+void print_repeat_summary(OutputBuffer &out) {
+    char text[48];
+    out << '\n';
+    out.repeat('=', separator_length) << '\n';
+    out << passes << (passes == 1 ? " pass" : " passes") << " in " << std::string_view(text, format_duration(passes_wall, text)) << '\n';
+    const char *headers[] = {"runs", "failed", "p50", "p90", "p99", "p99.9", "max"};
+    const size_t column_count = sizeof(headers) / sizeof(headers[0]);
+    size_t widths[column_count];
+    for (size_t column = 0; column < column_count; column++) {
+        widths[column] = std::strlen(headers[column]);
+        for (const RepeatHistory &history : histories) {
+            widths[column] = std::max(widths[column], format_repeat_column(history, column, text));
         }
-        if (!has_catch && has_failed(initial_assertions, assertions.size())) {
-            // Checks have failed in the test case but no error was thrown (no failed REQUIRE)
-            // Print test case
-            print_test(test);
-            // Print failed checks
-            print_assertions(initial_assertions, assertions_failed);
-            tests_failed++;
-        } else if (!has_catch && show_successful == true) {
-            print_test(test);
-            print_assertions(initial_assertions, assertions_failed);
+        out.repeat(' ', widths[column] - std::strlen(headers[column])) << headers[column] << "  ";
+    }
+    out << "test case" << '\n';
+    for (size_t i = 0; i < histories.size(); i++) {
+        for (size_t column = 0; column < column_count; column++) {
+            size_t length = format_repeat_column(histories[i], column, text);
+            out.repeat(' ', widths[column] - length) << std::string_view(text, length) << "  ";
+        }
+        out << tests[i]->test_name << '\n';
+    }
+}
+
+// Write test cases as a JSON document for tools that register them, such as coretest_discover_tests
+// Fields of a test case match the test_start event of the JSON Lines reporter
+void list_tests_json(OutputBuffer &out, const std::vector<const Test *> &listed) {
+    out << "{\"version\":1,\"tests\":[";
+    for (size_t i = 0; i < listed.size(); i++) {
+        const Test &test = *listed[i];
+        out << (i == 0 ? "" : ",") << '\n' << "{\"name\":";
+        write_json(out, test.test_name);
+        out << ",\"file\":";
+        write_json(out, test.file_name);
+        out << ",\"line\":" << test.line_number << ",\"tags\":";
+        write_json(out, test.tags);
+        out << ",\"serial\":" << (test.serial ? "true" : "false") << ",\"benchmark\":" << (test.benchmark ? "true" : "false")
+            << ",\"timeout\":" << test.timeout << "}";
+    }
+    out << '\n' << "]}" << '\n';
+}
+
+void list_tests(OutputBuffer &out) {
+    std::vector<const Test *> listed;
+    if (shard_count > 1) {
+        // Test cases a run of the shard would select, so that CI can check that shards cover every test case
+        select_tests();
+        listed = tests;
+    } else {
+        for (const Test *test = registry.first; test != nullptr; test = test->next) {
+            if (test_filter.matches(*test)) {
+                listed.push_back(test);
+            }
+        }
+    }
+    if (list_format == "json") {
+        list_tests_json(out, listed);
+        return;
+    }
+    out << '\n';
+    if (shard_count > 1) {
+        out << "Test cases in shard " << shard_index << " of " << shard_count << ":" << '\n';
+    } else if (test_filter.is_empty()) {
+        out << "All available test cases:" << '\n';
+    } else {
+        out << "Matching test cases:" << '\n';
+    }
+    for (const Test *test : listed) {
+        out.repeat(' ', 4) << test->test_name;
+        if (test->tags[0] != '\0') {
+            out << ' ' << test->tags;
         }
+        out << '\n';
     }
-    print_results(tests_failed, assertions_failed);
 }
 
-void print_durations() {
-    std::cout << '\n';
-    // Find longest duration length in string form
-    int max_duration_length = 0;
-    for (auto duration : durations) {
-        max_duration_length = std::max((int)(std::to_string(duration).length()), max_duration_length);
+// Add durations sampled in this run to the baseline file, keeping entries of other machines and test cases
+void write_baseline(const std::string &file_name) {
+    Baseline saved;
+    saved.read(file_name);
+    for (size_t i = 0; i < reports.size(); i++) {
+        if (reports[i].durations.samples > 0) {
+            saved.set(machine_name, tests[i]->test_name, reports[i].durations);
+        }
     }
-    for (size_t i = 0; i < durations.size(); i++) {
-        // Find spacing to align durations
-        std::string spacing = std::string(max_duration_length - (int)(std::to_string(durations[i]).length()), ' ');
-        std::cout << std::fixed << std::setprecision(3) << durations[i] << " ms: " << spacing << tests[i].test_name << '\n';
+    if (!saved.write(file_name)) {
+        raise_error("Failed to write baseline file: " + file_name);
     }
 }
 
-void list_tests() {
-    std::cout << '\n';
-    std::cout << "All available test cases:" << '\n';
-    for (auto test : tests) {
-        std::cout << std::string(4, ' ') << test.test_name << '\n';
+// Return duration argument of option in nanoseconds, a number followed by ms, s, m or h, seconds if there is no unit
+int64_t get_duration_argument(std::string option_name, std::string flag) {
+    const std::string &argument = options_unordered_map.at(option_name).get_argument();
+    char *end = nullptr;
+    double value = std::strtod(argument.c_str(), &end);
+    std::string unit = end;
+    const std::pair<const char *, double> units[] = {{"", 1e9}, {"ms", 1e6}, {"s", 1e9}, {"m", 60e9}, {"h", 3600e9}};
+    for (const auto &candidate : units) {
+        // Durations beyond int64_t nanoseconds, about 292 years, are rejected rather than overflowing
+        if (unit == candidate.first && end != argument.c_str() && value > 0 && value * candidate.second < 9e18) {
+            return (int64_t)(value * candidate.second);
+        }
+    }
+    raise_error("Invalid argument for " + flag + ": " + argument);
+}
+
+// Return percentage argument of option, such as 20%, as a fraction
+double get_percent_argument(std::string option_name, std::string flag) {
+    std::string argument = options_unordered_map.at(option_name).get_argument();
+    if (!argument.empty() && argument.back() == '%') {
+        argument.pop_back();
     }
+    char *end = nullptr;
+    double value = std::strtod(argument.c_str(), &end);
+    if (argument.empty() || *end != '\0' || !(value >= 0)) {
+        raise_error("Invalid argument for " + flag + ": " + options_unordered_map.at(option_name).get_argument());
+    }
+    return value / 100;
 }
 
-// Provided main
-void run_main(int argc, char **argv) {
+// Provided main, returns exit status which is non-zero if a test case has failed
+int run_main(int argc, char **argv) {
     initialize_options();
+    int exit_status = EXIT_SUCCESS;
     if (argc > 1) {
         // Parse args
         for (int i = 1; i < argc; i++) {
             std::string arg = argv[i];
             bool is_valid = false;
-            if (!test_case_option.is_match(arg)) {
+            // Long options may be given their argument as --option=argument
+            size_t equals = arg.find('=');
+            bool has_inline_argument = arg.compare(0, 2, "--") == 0 && equals != std::string::npos;
+            std::string inline_argument;
+            if (has_inline_argument) {
+                inline_argument = arg.substr(equals + 1);
+                arg.resize(equals);
+            }
+            if (has_inline_argument || !test_case_option.is_match(arg)) {
                 // Option is not in the form of a specified test case
-                for (std::pair<std::string, Option> element : options_unordered_map) {
-                    Option option = element.second;
+                for (auto &element : options_unordered_map) {
+                    Option &option = element.second;
                     if (option.is_match(arg)) {
                         is_valid = true;
-                        if (option.get_require_argument() == true) {
+                        if (has_inline_argument) {
+                            if (!option.get_require_argument()) {
+                                raise_error("Unexpected argument following " + arg);
+                            }
+                            option.set_argument(inline_argument);
+                        } else if (option.get_require_argument() == true) {
                             // Option requires argument
                             if (i == argc - 1) {
                                 // Current argument is last argument, no argument follows
-                                throw CoreTestError("Expected argument following " + arg);
+                                raise_error("Expected argument following " + arg);
                             }
                             std::string option_argument = argv[i + 1];
-                            options_unordered_map.at(element.first).set_argument(option_argument);
+                            option.set_argument(option_argument);
                             // Increment i to skip next argument
                             i++;
                         }
@@ -524,249 +4950,406 @@ void run_main(int argc, char **argv) {
                 is_valid = true;
             }
             if (!is_valid) {
-                throw CoreTestError("Unrecognized argument: " + arg);
+                raise_error("Unrecognized argument: " + arg);
             }
         }
     }
     if (!silence_output) {
         if (send_to_file) {
-            redirect_cout_to_file();
+            const std::string &file_name = options_unordered_map.at("out").get_argument();
+            if (!report_output.open_file(file_name)) {
+                raise_error("Failed to open output file: " + file_name);
+            }
+        } else {
+            report_output.open_standard_output();
+        }
+        reporter = make_reporter(set_reporter ? options_unordered_map.at("reporter").get_argument() : "console");
+        if (set_log_limit) {
+            assertion_log_limit = get_count_argument("log_limit", "--log-limit");
+        }
+#if !defined(CORETEST_COUNT_ALLOCATIONS)
+        if (check_leaks) {
+            raise_error("--leaks requires CORETEST_COUNT_ALLOCATIONS to be defined");
+        }
+#endif
+        if (set_filter) {
+            test_filter = TestFilter(options_unordered_map.at("filter").get_argument());
+        }
+        if (set_jobs) {
+            jobs = get_count_argument("jobs", "--jobs");
+            if (jobs == 0) {
+                jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+        }
+        if (set_timeout) {
+            timeout = (int64_t)get_count_argument("timeout", "--timeout");
+        }
+        if (set_stress_threads) {
+            stress_threads = get_count_argument("stress_threads", "--stress-threads");
+        }
+        if (set_stress_rounds) {
+            stress_rounds = std::max((size_t)1, get_count_argument("stress_rounds", "--stress-rounds"));
+        }
+        if (set_stress_time) {
+            stress_time = (int64_t)get_count_argument("stress_time", "--stress-time");
+        }
+        if (set_repeat) {
+            repeat_count = std::max((size_t)1, get_count_argument("repeat", "--repeat"));
+        }
+        if (set_soak) {
+            soak_duration = get_duration_argument("soak", "--soak");
+        }
+        if (set_order) {
+            test_order = options_unordered_map.at("order").get_argument();
+            bool is_random = test_order.compare(0, 7, "random:") == 0 && parse_unsigned(test_order.substr(7), order_seed);
+            if (test_order != "declared" && test_order != "slowest-first" && test_order != "fastest-first" && !is_random) {
+                raise_error("Invalid argument for --order: " + test_order + ", expected declared, slowest-first, fastest-first or random:<seed>");
+            }
+        }
+        if (fail_fast) {
+            max_failures = 1;
+        }
+        if (set_max_failures) {
+            max_failures = get_count_argument("max_failures", "--max-failures");
+        }
+        if (set_list_format) {
+            list_format = options_unordered_map.at("list_format").get_argument();
+            if (list_format != "text" && list_format != "json") {
+                raise_error("Invalid argument for --format: " + list_format + ", expected text or json");
+            }
+        }
+        if (set_shard_count) {
+            shard_count = get_count_argument("shard_count", "--shard-count");
+        }
+        if (set_shard_index) {
+            shard_index = get_count_argument("shard_index", "--shard-index");
+        }
+        if (shard_count == 0 || shard_index >= shard_count) {
+            raise_error("Invalid shard: --shard-index must be less than --shard-count");
+        }
+        if (set_shard_timings) {
+            const std::string &file_name = options_unordered_map.at("shard_timings").get_argument();
+            // Every shard must read the same durations, so a file that cannot be read is an error rather than ignored
+            if (!std::ifstream(file_name)) {
+                raise_error("Failed to read shard timings file: " + file_name);
+            }
+            shard_timings.read(file_name);
+        }
+        bool ordered_by_duration = test_order == "slowest-first" || test_order == "fastest-first";
+        if (set_state_file) {
+            state_file_name = options_unordered_map.at("state_file").get_argument();
+        } else if ((failed_first || rerun_failed || ordered_by_duration) && argc > 0) {
+            state_file_name = std::string(argv[0]) + ".coretest-state";
+        }
+        if (!state_file_name.empty()) {
+            run_state.read(state_file_name);
+        }
+        if (set_max_regression) {
+            max_regression = get_percent_argument("max_regression", "--max-regression");
+        }
+        if (save_baseline || compare_baseline) {
+            machine_name = get_machine_name();
+        }
+        if (compare_baseline) {
+            const std::string &file_name = options_unordered_map.at("compare_baseline").get_argument();
+            if (!baseline.read(file_name)) {
+                raise_error("Failed to read baseline file: " + file_name);
+            }
         }
         if (show_list) {
-            list_tests();
+            list_tests(report_output);
         } else if (show_help) {
-            print_help();
+            print_help(report_output);
         } else {
-            run_tests();
-            if (show_durations) {
-                print_durations();
+            RunTotals totals = run_tests();
+            if (!state_file_name.empty() && !run_state.write(state_file_name)) {
+                std::cerr << "coretest: failed to write run-state file " << state_file_name << '\n';
             }
+            if (save_baseline) {
+                write_baseline(options_unordered_map.at("save_baseline").get_argument());
+            }
+            exit_status = totals.tests_failed > 0 || totals.assertions_failed_unattributed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
         }
-        if (send_to_file) {
-            // Redirect buffer and close file
-            std::cout.rdbuf(coutbuf);
-            file_out.close();
-        }
+        report_output.close();
     }
+    return exit_status;
 }
-
+#endif
 }  // namespace coretest
 
-// Define test case macro
-#define TEST(test_name)                                                                      \
-    void test##test_name();                                                                  \
-    coretest::PushTest PushTest##test_name{test##test_name, #test_name, __FILE__, __LINE__}; \
+// Define test case macro, optionally followed by tags in the form "[tag1][tag2]" and a timeout in milliseconds
+#define TEST(...) CORETEST_TEST(false, __VA_ARGS__, "", )
+
+// Define test case macro for test cases that must not run concurrently with other test cases
+#define TEST_SERIAL(...) CORETEST_TEST(true, __VA_ARGS__, "", )
+
+#define CORETEST_TEST(serial, test_name, tags, ...)                                                                                                          \
+    void test##test_name();                                                                                                                                  \
+    coretest::Test TestCase##test_name{test##test_name, #test_name, __FILE__, __LINE__, tags, serial, false, coretest::get_timeout_argument(__VA_ARGS__ 0)}; \
+    void test##test_name()
+
+// Define test case macro whose body runs on a number of threads at once, released together for each round
+// Optionally followed by tags and a timeout, concurrent test cases run alone like serial test cases
+#define TEST_CONCURRENT(test_name, ...) CORETEST_TEST_CONCURRENT(test_name, __VA_ARGS__, "", )
+
+#define CORETEST_TEST_CONCURRENT(test_name, threads, tags, ...)                                                                                                               \
+    void test##test_name();                                                                                                                                                   \
+    coretest::Test TestCase##test_name{test##test_name, #test_name, __FILE__, __LINE__, tags, true, false, coretest::get_timeout_argument(__VA_ARGS__ 0), (size_t)(threads)}; \
     void test##test_name()
 
+// Define benchmark macro, optionally followed by tags, the body is one iteration of the benchmark
+#define BENCHMARK(...) CORETEST_BENCHMARK(__VA_ARGS__, "", )
+
+#define CORETEST_BENCHMARK(benchmark_name, tags, ...)                                                                               \
+    void benchmark##benchmark_name();                                                                                               \
+    coretest::Test BenchmarkCase##benchmark_name{benchmark##benchmark_name, #benchmark_name, __FILE__, __LINE__, tags, true, true}; \
+    void benchmark##benchmark_name()
+
+#if defined(CORETEST_COUNT_ALLOCATIONS)
+// Define allocation scope macros, followed by the block of code to check
+#define REQUIRE_NO_ALLOCATIONS \
+    for (coretest::AllocationScope allocation_scope(coretest::AssertionType::REQUIRE, 0); allocation_scope.next();)
+
+#define CHECK_NO_ALLOCATIONS \
+    for (coretest::AllocationScope allocation_scope(coretest::AssertionType::CHECK, 0); allocation_scope.next();)
+
+#define REQUIRE_MAX_ALLOCATIONS(n) \
+    for (coretest::AllocationScope allocation_scope(coretest::AssertionType::REQUIRE, n); allocation_scope.next();)
+
+#define CHECK_MAX_ALLOCATIONS(n) \
+    for (coretest::AllocationScope allocation_scope(coretest::AssertionType::CHECK, n); allocation_scope.next();)
+#endif
+
 // Define section macro
 #define SECTION(section_name)
 
 // Define assertion macros
+// Each macro expands to one call, operands are only formatted out of line when the assertion is recorded
+// The call returns if the assertion has passed, a failed REQUIRE then returns from the test function if exceptions are disabled
+#if defined(CORETEST_NO_EXCEPTIONS)
+#define CORETEST_ASSERT_REQUIRE(...) \
+    if (!(__VA_ARGS__)) return;      \
+    else (void)0
+#else
+#define CORETEST_ASSERT_REQUIRE(...) __VA_ARGS__
+#endif
+
+#define CORETEST_ASSERT_CHECK(...) __VA_ARGS__
+
+// Decompose expression, such as REQUIRE(a == b), to print its operands
+// Decomposing relies on <= binding tighter than the comparison that follows it, which GCC warns about
+#if defined(__GNUC__) || defined(__clang__)
+#define CORETEST_DECOMPOSE(type, ...)                                                                                                  \
+    do {                                                                                                                               \
+        _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wparentheses\"")                                             \
+            CORETEST_ASSERT_##type(coretest::assert_expression(coretest::Decomposer<coretest::AssertionType::type>() <= __VA_ARGS__)); \
+        _Pragma("GCC diagnostic pop")                                                                                                  \
+    } while (false)
+#else
+#define CORETEST_DECOMPOSE(type, ...)                                                                                              \
+    do {                                                                                                                           \
+        CORETEST_ASSERT_##type(coretest::assert_expression(coretest::Decomposer<coretest::AssertionType::type>() <= __VA_ARGS__)); \
+    } while (false)
+#endif
+
+#define REQUIRE(...) CORETEST_DECOMPOSE(REQUIRE, __VA_ARGS__)
+
+#define CHECK(...) CORETEST_DECOMPOSE(CHECK, __VA_ARGS__)
+
+#define REQUIRE_TRUE(x) CORETEST_ASSERT_REQUIRE(coretest::assert_boolean(coretest::AssertionType::REQUIRE, coretest::ComparisonType::TRUE, x))
+
+#define REQUIRE_FALSE(x) CORETEST_ASSERT_REQUIRE(coretest::assert_boolean(coretest::AssertionType::REQUIRE, coretest::ComparisonType::FALSE, x))
+
+#define REQUIRE_EQUAL(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::EQUAL>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define REQUIRE_NOT_EQUAL(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::NOT_EQUAL>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define REQUIRE_LESS(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::LESS>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define REQUIRE_LESS_EQUAL(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::LESS_EQUAL>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define REQUIRE_GREATER(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::GREATER>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define REQUIRE_GREATER_EQUAL(x, y) CORETEST_ASSERT_REQUIRE(coretest::assert_comparison<coretest::ComparisonType::GREATER_EQUAL>(coretest::AssertionType::REQUIRE, false, x, y))
+
+#define CHECK_TRUE(x) CORETEST_ASSERT_CHECK(coretest::assert_boolean(coretest::AssertionType::CHECK, coretest::ComparisonType::TRUE, x))
+
+#define CHECK_FALSE(x) CORETEST_ASSERT_CHECK(coretest::assert_boolean(coretest::AssertionType::CHECK, coretest::ComparisonType::FALSE, x))
+
+#define CHECK_EQUAL(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::EQUAL>(coretest::AssertionType::CHECK, false, x, y))
+
+#define CHECK_NOT_EQUAL(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::NOT_EQUAL>(coretest::AssertionType::CHECK, false, x, y))
+
+#define CHECK_LESS(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::LESS>(coretest::AssertionType::CHECK, false, x, y))
+
+#define CHECK_LESS_EQUAL(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::LESS_EQUAL>(coretest::AssertionType::CHECK, false, x, y))
+
+#define CHECK_GREATER(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::GREATER>(coretest::AssertionType::CHECK, false, x, y))
+
+#define CHECK_GREATER_EQUAL(x, y) CORETEST_ASSERT_CHECK(coretest::assert_comparison<coretest::ComparisonType::GREATER_EQUAL>(coretest::AssertionType::CHECK, false, x, y))
+
+#define REQUIRE_RANGE_EQUAL(x, y) \
+    CORETEST_ASSERT_REQUIRE(coretest::add_range_assertion(coretest::AssertionType::REQUIRE, coretest::ComparisonType::RANGE_EQUAL, x, y, coretest::RangeTolerance{}))
+
+#define REQUIRE_RANGE_NEAR(x, y, abs_tol, rel_tol) \
+    CORETEST_ASSERT_REQUIRE(coretest::add_range_assertion(coretest::AssertionType::REQUIRE, coretest::ComparisonType::RANGE_NEAR, x, y, coretest::RangeTolerance{(double)(abs_tol), (double)(rel_tol), 0}))
+
+#define REQUIRE_ULP(x, y, max_ulps) \
+    CORETEST_ASSERT_REQUIRE(coretest::add_range_assertion(coretest::AssertionType::REQUIRE, coretest::ComparisonType::ULP, x, y, coretest::RangeTolerance{0, 0, (uint64_t)(max_ulps)}))
+
+#define CHECK_RANGE_EQUAL(x, y) \
+    CORETEST_ASSERT_CHECK(coretest::add_range_assertion(coretest::AssertionType::CHECK, coretest::ComparisonType::RANGE_EQUAL, x, y, coretest::RangeTolerance{}))
+
+#define CHECK_RANGE_NEAR(x, y, abs_tol, rel_tol) \
+    CORETEST_ASSERT_CHECK(coretest::add_range_assertion(coretest::AssertionType::CHECK, coretest::ComparisonType::RANGE_NEAR, x, y, coretest::RangeTolerance{(double)(abs_tol), (double)(rel_tol), 0}))
+
+#define CHECK_ULP(x, y, max_ulps) \
+    CORETEST_ASSERT_CHECK(coretest::add_range_assertion(coretest::AssertionType::CHECK, coretest::ComparisonType::ULP, x, y, coretest::RangeTolerance{0, 0, (uint64_t)(max_ulps)}))
+
+#if defined(CORETEST_IMPLEMENTATION) && defined(CORETEST_COUNT_ALLOCATIONS)
+namespace coretest {
+// Size of the header placed before each allocation, which holds the context that counted it followed by its size
+const size_t allocation_header_size = alignof(std::max_align_t);
+static_assert(allocation_header_size >= sizeof(size_t) + sizeof(TestContext *), "Allocation header must hold a size and a context");
+
+// Count allocation in the test case running on this thread, returns its context or nullptr if it is not counted
+inline TestContext *count_allocation(size_t size) {
+    TestContext &context = *current_context;
+    if (!context.count_allocations) {
+        return nullptr;
+    }
+    AllocationCounters &counters = context.result.allocations;
+    counters.allocations++;
+    counters.bytes += size;
+    counters.live_bytes += size;
+    counters.peak_live_bytes = std::max(counters.peak_live_bytes, counters.live_bytes);
+    return &context;
+}
+
+// Count free of a block in the context that counted its allocation, so that blocks freed by other threads,
+// such as the state of a std::thread started by the test case, are not reported as leaked
+// A block freed after its test case has ended is counted in the next test case of that context
+inline void count_free(TestContext *owner, size_t size) {
+    if (owner == nullptr) {
+        return;
+    }
+    if (owner == current_context) {
+        AllocationCounters &counters = owner->result.allocations;
+        counters.frees++;
+        counters.live_bytes -= size;
+    } else {
+        owner->remote_frees.fetch_add(1, std::memory_order_relaxed);
+        owner->remote_freed_bytes.fetch_add((int64_t)size, std::memory_order_relaxed);
+    }
+}
+
+inline void *counted_allocate(size_t size, size_t alignment) {
+    size_t header_size = std::max(allocation_header_size, alignment);
+    void *block;
+    if (alignment > allocation_header_size) {
+        // Size given to aligned_alloc must be a multiple of alignment
+        block = aligned_alloc(alignment, (header_size + size + alignment - 1) / alignment * alignment);
+    } else {
+        block = malloc(header_size + size);
+    }
+    if (block == nullptr) {
+        return nullptr;
+    }
+    char *pointer = static_cast<char *>(block) + header_size;
+    reinterpret_cast<size_t *>(pointer)[-1] = size;
+    reinterpret_cast<TestContext **>(pointer - sizeof(size_t))[-1] = count_allocation(size);
+    return pointer;
+}
+
+inline void counted_free(void *pointer, size_t alignment) {
+    if (pointer == nullptr) {
+        return;
+    }
+    char *bytes = static_cast<char *>(pointer);
+    count_free(reinterpret_cast<TestContext **>(bytes - sizeof(size_t))[-1], reinterpret_cast<size_t *>(bytes)[-1]);
+    free(static_cast<char *>(pointer) - std::max(allocation_header_size, alignment));
+}
+
+inline void *counted_new(size_t size, size_t alignment) {
+    void *pointer = counted_allocate(size, alignment);
+    if (pointer == nullptr) {
+#if defined(CORETEST_NO_EXCEPTIONS)
+        std::abort();
+#else
+        throw std::bad_alloc();
+#endif
+    }
+    return pointer;
+}
+}  // namespace coretest
+
+// Replace global allocation functions to count allocations per test case
+void *operator new(std::size_t size) {
+    return coretest::counted_new(size, coretest::allocation_header_size);
+}
+void *operator new[](std::size_t size) {
+    return coretest::counted_new(size, coretest::allocation_header_size);
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return coretest::counted_allocate(size, coretest::allocation_header_size);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return coretest::counted_allocate(size, coretest::allocation_header_size);
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return coretest::counted_new(size, static_cast<size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return coretest::counted_new(size, static_cast<size_t>(alignment));
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return coretest::counted_allocate(size, static_cast<size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return coretest::counted_allocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void *pointer) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete[](void *pointer) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete(void *pointer, std::size_t) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete[](void *pointer, std::size_t) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    coretest::counted_free(pointer, coretest::allocation_header_size);
+}
+void operator delete(void *pointer, std::align_val_t alignment) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+void operator delete(void *pointer, std::size_t, std::align_val_t alignment) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, std::size_t, std::align_val_t alignment) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+void operator delete(void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+void operator delete[](void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    coretest::counted_free(pointer, static_cast<size_t>(alignment));
+}
+#endif
 
-#define REQUIRE_EQUAL(x, y)                     \
-    {                                           \
-        auto first = x;                         \
-        auto second = y;                        \
-        coretest::Assertion assertion = {       \
-            ((first == second) ? true : false), \
-            coretest::AssertionType::REQUIRE,   \
-            coretest::ComparisonType::EQUAL,    \
-            coretest::get_string(first),        \
-            coretest::get_string(second)};      \
-        coretest::add_assertion(assertion);     \
-    }
-
-#define REQUIRE_TRUE(x)                       \
-    {                                         \
-        auto first = x;                       \
-        coretest::Assertion assertion = {     \
-            ((first == true) ? true : false), \
-            coretest::AssertionType::REQUIRE, \
-            coretest::ComparisonType::TRUE,   \
-            coretest::get_string(first)};     \
-        coretest::add_assertion(assertion);   \
-    }
-
-#define REQUIRE_FALSE(x)                       \
-    {                                          \
-        auto first = x;                        \
-        coretest::Assertion assertion = {      \
-            ((first == false) ? true : false), \
-            coretest::AssertionType::REQUIRE,  \
-            coretest::ComparisonType::FALSE,   \
-            coretest::get_string(first)};      \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define REQUIRE_NOT_EQUAL(x, y)                  \
-    {                                            \
-        auto first = x;                          \
-        auto second = y;                         \
-        coretest::Assertion assertion = {        \
-            ((first != second) ? true : false),  \
-            coretest::AssertionType::REQUIRE,    \
-            coretest::ComparisonType::NOT_EQUAL, \
-            coretest::get_string(first),         \
-            coretest::get_string(second)};       \
-        coretest::add_assertion(assertion);      \
-    }
-
-#define REQUIRE_LESS(x, y)                     \
-    {                                          \
-        auto first = x;                        \
-        auto second = y;                       \
-        coretest::Assertion assertion = {      \
-            ((first < second) ? true : false), \
-            coretest::AssertionType::REQUIRE,  \
-            coretest::ComparisonType::LESS,    \
-            coretest::get_string(first),       \
-            coretest::get_string(second)};     \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define REQUIRE_LESS_EQUAL(x, y)                  \
-    {                                             \
-        auto first = x;                           \
-        auto second = y;                          \
-        coretest::Assertion assertion = {         \
-            ((first <= second) ? true : false),   \
-            coretest::AssertionType::REQUIRE,     \
-            coretest::ComparisonType::LESS_EQUAL, \
-            coretest::get_string(first),          \
-            coretest::get_string(second)};        \
-        coretest::add_assertion(assertion);       \
-    }
-
-#define REQUIRE_GREATER(x, y)                  \
-    {                                          \
-        auto first = x;                        \
-        auto second = y;                       \
-        coretest::Assertion assertion = {      \
-            ((first > second) ? true : false), \
-            coretest::AssertionType::REQUIRE,  \
-            coretest::ComparisonType::GREATER, \
-            coretest::get_string(first),       \
-            coretest::get_string(second)};     \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define REQUIRE_GREATER_EQUAL(x, y)                  \
-    {                                                \
-        auto first = x;                              \
-        auto second = y;                             \
-        coretest::Assertion assertion = {            \
-            ((first >= second) ? true : false),      \
-            coretest::AssertionType::REQUIRE,        \
-            coretest::ComparisonType::GREATER_EQUAL, \
-            coretest::get_string(first),             \
-            coretest::get_string(second)};           \
-        coretest::add_assertion(assertion);          \
-    }
-
-#define CHECK_EQUAL(x, y)                       \
-    {                                           \
-        auto first = x;                         \
-        auto second = y;                        \
-        coretest::Assertion assertion = {       \
-            ((first == second) ? true : false), \
-            coretest::AssertionType::CHECK,     \
-            coretest::ComparisonType::EQUAL,    \
-            coretest::get_string(first),        \
-            coretest::get_string(second)};      \
-        coretest::add_assertion(assertion);     \
-    }
-
-#define CHECK_TRUE(x)                         \
-    {                                         \
-        auto first = x;                       \
-        coretest::Assertion assertion = {     \
-            ((first == true) ? true : false), \
-            coretest::AssertionType::CHECK,   \
-            coretest::ComparisonType::TRUE,   \
-            coretest::get_string(first)};     \
-        coretest::add_assertion(assertion);   \
-    }
-
-#define CHECK_FALSE(x)                         \
-    {                                          \
-        auto first = x;                        \
-        coretest::Assertion assertion = {      \
-            ((first == false) ? true : false), \
-            coretest::AssertionType::CHECK,    \
-            coretest::ComparisonType::FALSE,   \
-            coretest::get_string(first)};      \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define CHECK_NOT_EQUAL(x, y)                    \
-    {                                            \
-        auto first = x;                          \
-        auto second = y;                         \
-        coretest::Assertion assertion = {        \
-            ((first != second) ? true : false),  \
-            coretest::AssertionType::CHECK,      \
-            coretest::ComparisonType::NOT_EQUAL, \
-            coretest::get_string(first),         \
-            coretest::get_string(second)};       \
-        coretest::add_assertion(assertion);      \
-    }
-
-#define CHECK_LESS(x, y)                       \
-    {                                          \
-        auto first = x;                        \
-        auto second = y;                       \
-        coretest::Assertion assertion = {      \
-            ((first < second) ? true : false), \
-            coretest::AssertionType::CHECK,    \
-            coretest::ComparisonType::LESS,    \
-            coretest::get_string(first),       \
-            coretest::get_string(second)};     \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define CHECK_LESS_EQUAL(x, y)                    \
-    {                                             \
-        auto first = x;                           \
-        auto second = y;                          \
-        coretest::Assertion assertion = {         \
-            ((first <= second) ? true : false),   \
-            coretest::AssertionType::CHECK,       \
-            coretest::ComparisonType::LESS_EQUAL, \
-            coretest::get_string(first),          \
-            coretest::get_string(second)};        \
-        coretest::add_assertion(assertion);       \
-    }
-
-#define CHECK_GREATER(x, y)                    \
-    {                                          \
-        auto first = x;                        \
-        auto second = y;                       \
-        coretest::Assertion assertion = {      \
-            ((first > second) ? true : false), \
-            coretest::AssertionType::CHECK,    \
-            coretest::ComparisonType::GREATER, \
-            coretest::get_string(first),       \
-            coretest::get_string(second)};     \
-        coretest::add_assertion(assertion);    \
-    }
-
-#define CHECK_GREATER_EQUAL(x, y)                    \
-    {                                                \
-        auto first = x;                              \
-        auto second = y;                             \
-        coretest::Assertion assertion = {            \
-            ((first >= second) ? true : false),      \
-            coretest::AssertionType::CHECK,          \
-            coretest::ComparisonType::GREATER_EQUAL, \
-            coretest::get_string(first),             \
-            coretest::get_string(second)};           \
-        coretest::add_assertion(assertion);          \
-    }
-
-#if !defined(CORETEST_IMPLEMENT_WITHOUT_MAIN)
+#if defined(CORETEST_MAIN)
 // Standard main entry point
 int main(int argc, char **argv) {
-    coretest::run_main(argc, argv);
+    return coretest::run_main(argc, argv);
 }
 #endif
 #endif
\ No newline at end of file
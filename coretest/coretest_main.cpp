@@ -0,0 +1,4 @@
+// Runner and main of coretest::main, linked into test executables whose source files only include the header
+#define CORETEST_MAIN
+
+#include "coretest.hpp"
@@ -1,3 +1,5 @@
+#define CORETEST_MAIN
+
 #include "../coretest/coretest.hpp"
 
 int add(int a, int b) {
@@ -0,0 +1,38 @@
+#define CORETEST_IMPLEMENTATION
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#include "../coretest/coretest.hpp"
+
+// Test cases that fail, crash or hang, run by CTest with options whose output it checks
+// Runs name the test cases they need, as a run of all of them ends at the first crash
+
+TEST(passes) {
+    CHECK_EQUAL(1, 1);
+}
+
+TEST(fails) {
+    CHECK_EQUAL(1, 2);
+}
+
+TEST(crashes) {
+    std::abort();
+}
+
+TEST(exits) {
+    std::exit(3);
+}
+
+TEST(sleeps) {
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+}
+
+TEST(passes_last) {
+    CHECK_EQUAL(2, 2);
+}
+
+int main(int argc, char **argv) {
+    return coretest::run_main(argc, argv);
+}
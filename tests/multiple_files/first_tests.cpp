@@ -0,0 +1,8 @@
+#include <coretest/coretest.hpp>
+
+#include "shared.hpp"
+
+TEST(first_file) {
+    REQUIRE_EQUAL(square(3), 9);
+    CHECK_RANGE_EQUAL(std::vector<int>({1, 4}), std::vector<int>({square(1), square(2)}));
+}
@@ -0,0 +1,8 @@
+#include <coretest/coretest.hpp>
+
+#include "shared.hpp"
+
+TEST(second_file, "[tag]") {
+    REQUIRE_EQUAL(square(-2), 4);
+    CHECK_EQUAL(coretest::get_string(std::vector<int>({square(2)})), "{4}");
+}
@@ -0,0 +1,9 @@
+#ifndef SHARED_HPP
+#define SHARED_HPP
+
+// Function tested from both source files
+inline int square(int value) {
+    return value * value;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#define CORETEST_IMPLEMENTATION
+
+#include "../coretest/coretest.hpp"
+
+// Built without exceptions, where a failed require returns from its test case
+
+TEST(require_returns) {
+    REQUIRE_EQUAL(1, 2);
+    // Not reached, a second failure shows that the require fell through
+    CHECK_EQUAL(3, 4);
+}
+
+TEST(runs_after_require) {
+    CHECK_EQUAL(5, 5);
+}
+
+int main(int argc, char **argv) {
+    return coretest::run_main(argc, argv);
+}
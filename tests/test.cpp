@@ -1,4 +1,5 @@
-#define CORETEST_IMPLEMENT_WITHOUT_MAIN
+#define CORETEST_IMPLEMENTATION
+#define CORETEST_COUNT_ALLOCATIONS
 
 #include "../coretest/coretest.hpp"
 
@@ -40,6 +41,172 @@ TEST(require_greater_equal) {
     REQUIRE_GREATER_EQUAL(2, 1);
 }
 
+TEST(tagged_test, "[tag][other_tag]") {
+    REQUIRE_TRUE(1);
+}
+
+TEST(pattern_matching) {
+    REQUIRE_TRUE(coretest::Pattern("foo").matches("foo"));
+    REQUIRE_FALSE(coretest::Pattern("foo").matches("foobar"));
+    REQUIRE_TRUE(coretest::Pattern("foo*").matches("foobar"));
+    REQUIRE_TRUE(coretest::Pattern("*bar").matches("foobar"));
+    REQUIRE_TRUE(coretest::Pattern("*oba*").matches("foobar"));
+    REQUIRE_TRUE(coretest::Pattern("f?o*a?").matches("foobar"));
+    REQUIRE_TRUE(coretest::Pattern("f*b*r").matches("foobar"));
+    REQUIRE_FALSE(coretest::Pattern("f*b*z").matches("foobar"));
+}
+
+TEST(reporter_escaping) {
+    coretest::OutputBuffer json;
+    coretest::write_json(json, "a\"b\\c\n\x01");
+    REQUIRE_EQUAL(std::string(json.view()), "\"a\\\"b\\\\c\\n\\u0001\"");
+    coretest::OutputBuffer xml;
+    coretest::escape_xml(xml, "<a & \"b\">");
+    REQUIRE_EQUAL(std::string(xml.view()), "&lt;a &amp; &quot;b&quot;&gt;");
+}
+
+TEST(output_formatting) {
+    coretest::OutputBuffer out;
+    out << 0 << ' ' << -42 << ' ' << (size_t)18446744073709551615ull << ' ' << (long long)(-9223372036854775807ll - 1);
+    REQUIRE_EQUAL(std::string(out.view()), "0 -42 18446744073709551615 -9223372036854775808");
+    out.clear();
+    out << coretest::FixedPoint{3.14159, 3} << ' ' << coretest::FixedPoint{-0.5, 2} << ' ' << coretest::FixedPoint{0.9996, 3} << ' ' << coretest::FixedPoint{2.5, 0};
+    REQUIRE_EQUAL(std::string(out.view()), "3.142 -0.50 1.000 3");
+}
+
+TEST(baseline_file) {
+    const char *file_name = "baseline_file_test.txt";
+    coretest::Baseline saved;
+    coretest::DurationStatistics statistics;
+    statistics.samples = 10;
+    statistics.median = 1500.5;
+    statistics.deviation = 20;
+    statistics.min = 1400;
+    saved.set("first machine", "test_case", statistics);
+    saved.set("second machine", "test_case", coretest::DurationStatistics());
+    REQUIRE_TRUE(saved.write(file_name));
+    coretest::Baseline loaded;
+    REQUIRE_TRUE(loaded.read(file_name));
+    std::remove(file_name);
+    const coretest::DurationStatistics *found = loaded.find("first machine", "test_case");
+    REQUIRE_TRUE(found != nullptr);
+    CHECK_EQUAL(found->samples, 10u);
+    CHECK_EQUAL(found->median, 1500.5);
+    CHECK_TRUE(loaded.find("second machine", "test_case") != nullptr);
+    CHECK_TRUE(loaded.find("third machine", "test_case") == nullptr);
+}
+
+TEST(run_state_file) {
+    const char *file_name = "run_state_file_test.txt";
+    coretest::RunState saved;
+    saved.set("failing_case", coretest::TestState{true, 2500});
+    saved.set("passing_case", coretest::TestState{false, 100});
+    REQUIRE_TRUE(saved.write(file_name));
+    coretest::RunState loaded;
+    loaded.read(file_name);
+    std::remove(file_name);
+    // Writers lock a file next to the state file, which is left for later writers
+    std::remove((std::string(file_name) + ".lock").c_str());
+    const coretest::TestState *found = loaded.find("failing_case");
+    REQUIRE_TRUE(found != nullptr);
+    CHECK_TRUE(found->failed);
+    CHECK_EQUAL(found->duration, 2500);
+    CHECK_FALSE(loaded.find("passing_case")->failed);
+    CHECK_TRUE(loaded.find("new_case") == nullptr);
+}
+
+TEST(timeout_argument, "[timeout]", 60000) {
+    REQUIRE_EQUAL(TestCasetimeout_argument.timeout, 60000);
+    REQUIRE_EQUAL(TestCasetagged_test.timeout, 0);
+    REQUIRE_EQUAL(coretest::get_timeout_argument(std::chrono::seconds(2), "", 0), 2000);
+}
+
+TEST(range_comparisons) {
+    std::vector<float> first(1003);
+    for (size_t i = 0; i < first.size(); i++) {
+        first[i] = (float)i * 0.25f;
+    }
+    std::vector<float> second = first;
+    REQUIRE_RANGE_EQUAL(first, second);
+    second[7] = std::nextafter(second[7], 1000.0f);
+    second[1001] += 1.0f;
+    REQUIRE_RANGE_NEAR(first, second, 1.5, 0);
+    coretest::RangeMismatches mismatches = coretest::compare_elements(first.data(), second.data(), first.size(), coretest::ComparisonType::ULP, coretest::RangeTolerance{0, 0, 1});
+    REQUIRE_EQUAL(mismatches.count, 1u);
+    REQUIRE_EQUAL(mismatches.indices[0], 1001u);
+    REQUIRE_ULP(0.1 + 0.2, 0.3, 1);
+    REQUIRE_RANGE_NEAR(std::vector<double>({100.0, -0.0}), std::vector<double>({101.0, 0.0}), 0, 0.01);
+    int values[] = {1, 2, 3};
+    REQUIRE_RANGE_EQUAL(values, std::vector<int>({1, 2, 3}));
+}
+
+TEST(string_maker) {
+    REQUIRE_EQUAL(coretest::get_string(std::vector<int>({1, 2, 3})), "{1, 2, 3}");
+    REQUIRE_EQUAL(coretest::get_string(std::make_pair(1, std::string("a"))), "{1, \"a\"}");
+    REQUIRE_EQUAL(coretest::get_string(std::optional<int>()), "nullopt");
+    REQUIRE_EQUAL(coretest::get_string(std::string_view("text")), "text");
+    std::string elided = coretest::get_string(std::vector<int>(1000000));
+    REQUIRE_LESS(elided.size(), 2 * coretest::max_value_length);
+    REQUIRE_EQUAL(elided.substr(elided.size() - 6), " more}");
+}
+
+TEST(expression_decomposition) {
+    int a = 1;
+    std::string name = "foo";
+    REQUIRE(a == 1);
+    REQUIRE(a + 1 > a);
+    REQUIRE(name != "bar");
+    REQUIRE((a == 1 && name == "foo"));
+    CHECK(a);
+    CHECK(!name.empty());
+}
+
+TEST_SERIAL(assertions_from_threads) {
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < 4; worker++) {
+        workers.emplace_back([worker] {
+            for (int i = 0; i < 1000; i++) {
+                CHECK_EQUAL(i + worker, worker + i);
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+TEST(allocations_freed_by_threads) {
+    // The thread state and the vector are allocated here and freed by the started thread
+    std::vector<int> *values = new std::vector<int>(100);
+    std::thread worker([values] { delete values; });
+    worker.join();
+    REQUIRE_GREATER_EQUAL(coretest::current_context->remote_freed_bytes.load(), (int64_t)(100 * sizeof(int)));
+}
+
+std::atomic<int> concurrent_calls{0};
+
+TEST_CONCURRENT(concurrent_test, 4) {
+    concurrent_calls.fetch_add(1);
+    CHECK_LESS(coretest::get_thread_index(), 4);
+}
+
+TEST(duration_histogram) {
+    coretest::DurationHistogram histogram;
+    for (int64_t duration = 1; duration <= 100000; duration++) {
+        histogram.record(duration);
+    }
+    REQUIRE_EQUAL(histogram.get_count(), 100000u);
+    REQUIRE_EQUAL(histogram.get_max(), 100000u);
+    REQUIRE_RANGE_NEAR((double)histogram.get_percentile(0.5), 50000.0, 0, 0.016);
+    REQUIRE_RANGE_NEAR((double)histogram.get_percentile(0.999), 99900.0, 0, 0.016);
+    REQUIRE_EQUAL(histogram.get_percentile(0.00001), 1u);
+    // Durations past the range of the buckets are counted in the last bucket
+    histogram.record(int64_t(1) << 50);
+    REQUIRE_EQUAL(histogram.get_count(), 100001u);
+    REQUIRE_EQUAL(histogram.get_max(), uint64_t(1) << 50);
+    REQUIRE_GREATER_EQUAL(histogram.get_percentile(1.0), uint64_t(1) << 39);
+}
+
 TEST(float_type) {
     float a = 1.;
     float b = 1.;
@@ -106,12 +273,50 @@ TEST(unsigned_long_type) {
     REQUIRE_EQUAL(a, b);
 }
 
+TEST_SERIAL(serial_test) {
+    REQUIRE_TRUE(1);
+}
+
 TEST(double_evaluation) {
     int i = 0;
     REQUIRE_EQUAL(i++, 0);
     REQUIRE_EQUAL(i, 1);
 }
 
+TEST(allocation_scopes) {
+    int a = 1;
+    REQUIRE_NO_ALLOCATIONS {
+        a++;
+    }
+    CHECK_MAX_ALLOCATIONS(1) {
+        std::vector<int> values(4);
+    }
+    REQUIRE_EQUAL(a, 2);
+}
+
+TEST(perf_counters_query) {
+    coretest::PerfCounts before = coretest::read_perf_counters();
+    if (!coretest::perf_counters_available()) {
+        REQUIRE_EQUAL(before.available, 0u);
+        return;
+    }
+    REQUIRE_NOT_EQUAL(before.available, 0u);
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < 10000; i++) {
+        sum += i;
+        coretest::do_not_optimize(sum);
+    }
+    coretest::PerfCounts after = coretest::read_perf_counters();
+    if (after.is_available(1)) {
+        CHECK_GREATER(after.instructions, before.instructions);
+    }
+}
+
+BENCHMARK(benchmark_test) {
+    int a = 1;
+    coretest::do_not_optimize(a + 1);
+}
+
 int main(int argc, char **argv) {
-    coretest::run_main(argc, argv);
+    return coretest::run_main(argc, argv);
 }
\ No newline at end of file